@@ -0,0 +1,51 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_ALIGN_H
+#define TEXT_TO_MORSE_ALIGN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* FLAC APPLICATION block id used for the text-to-sample index */
+#define ALIGN_APPLICATION_ID "TTMI"
+
+/* kinds of marks; the first character of a line is also a word start */
+#define ALIGN_WORD (1)
+#define ALIGN_LINE (2)
+
+struct align_mark {
+	uint64_t byte;		/* offset of the character in the input text */
+	uint64_t sample;	/* first sample of the character in the audio */
+	int kind;
+};
+
+void align_enable(void);
+int align_is_enabled(void);
+void align_char(unsigned char c, uint64_t byte, uint64_t sample);
+
+struct align_mark *align_get_marks(void);
+size_t align_get_marks_len(void);
+
+unsigned char *align_serialize(size_t *len);
+int align_write(char *filepath);
+void align_exit(void);
+
+#endif
@@ -0,0 +1,56 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_DECODE_H
+#define TEXT_TO_MORSE_DECODE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* detector settings - 5 ms analysis blocks, tone search range and step */
+#define DECODE_BLOCK_MS (5)
+#define DECODE_MIN_FREQUENCY (300)
+#define DECODE_MAX_FREQUENCY (1200)
+#define DECODE_FREQUENCY_STEP (10)
+
+/* samples per Goertzel block when searching for the tone, then when refining it to 1 Hz */
+#define DECODE_SEARCH_BLOCK (512)
+#define DECODE_REFINE_BLOCK (128)
+
+/* what decode_samples() found out about the signal */
+struct decode_stats {
+	int frequency;
+	double wpm;
+	size_t characters;
+	size_t unknown;
+};
+
+/* one input of decode_files() */
+struct decode_job {
+	char *filepath;
+	char *text;
+	struct decode_stats stats;
+	int rc;
+};
+
+char *decode_samples(int16_t *samples, size_t len, int rate, int frequency, struct decode_stats *stats);
+int decode_files(char **filepaths, size_t n, char *output, int frequency, int jobs, struct decode_job *results);
+
+#endif
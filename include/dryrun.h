@@ -0,0 +1,37 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_DRYRUN_H
+#define TEXT_TO_MORSE_DRYRUN_H
+
+#include "measure.h"
+
+/*
+ * Rough FLAC cost of the audio at COMPRESSION_LEVEL 8. Shaped tone
+ * compresses to about 5 bits per sample, silence to constant subframes,
+ * plus a frame header and CRCs for every block.
+ */
+#define DRYRUN_TONE_BITS (5.0)
+#define DRYRUN_FRAME_BYTES (16)
+#define DRYRUN_BLOCKSIZE (4096)
+
+int dryrun_file(char *filepath, const struct measure *m, int seek_interval);
+
+#endif
@@ -24,6 +24,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "frames.h"
+#include "verify.h"
+
 /* Audio Settings - 8 kHz sample rate, 16 bits per sample, mono.
  * Original was 44.1 kHz but no perceptable difference at 8 kHz,
  * so it was reduced to keep output file sizes small.
@@ -32,10 +35,29 @@
 #define SAMPLE_RATE (8000)
 #define BPS (16)
 
-/* encoder settings - max compression level (8), verify enabled */
+/* encoder settings - max compression level (8), libFLAC's inline verify
+ * disabled; the output is verified on a separate thread instead (verify.h)
+ */
 #define COMPRESSION_LEVEL (8)
-#define VERIFY (1)
+#define VERIFY (0)
+
+/* metadata - a seek point every 10 seconds of audio */
+#define SEEK_INTERVAL (10)
+
+void encoder_set_seek_interval(int seconds);
+void encoder_set_application(char *id, unsigned char *data, size_t len);
+
+/* incremental interface: samples can be handed over as they are rendered */
+struct encoder_stream;
+
+struct encoder_stream *encoder_stream_open(char *filepath, size_t total_samples, struct verify *v);
+struct encoder_stream *encoder_stream_reopen(struct encoder_stream *s, char *filepath, size_t total_samples, struct verify *v);
+int encoder_stream_write(struct encoder_stream *s, const int16_t *samples, size_t nsamples);
+int encoder_stream_finish(struct encoder_stream *s, struct frame_list *frames);
+void encoder_stream_free(struct encoder_stream *s);
+int encoder_stream_close(struct encoder_stream *s, struct frame_list *frames);
 
-int encoder_encode(char *filepath, int16_t *result, size_t result_len, size_t total_samples);
+int encoder_encode(char *filepath, const int16_t *result, size_t result_len, size_t total_samples, struct verify *v, struct frame_list *frames);
+int encoder_encode_frames(const int16_t *samples, size_t nsamples, struct frame_list *l);
 
 #endif
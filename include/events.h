@@ -0,0 +1,49 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_EVENTS_H
+#define TEXT_TO_MORSE_EVENTS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* output formats */
+#define EVENTS_BINARY (0)
+#define EVENTS_CSV (1)
+#define EVENTS_JSON (2)
+
+/*
+ * Binary format: "TTMK", the sample rate as a little-endian uint32, then
+ * one unsigned LEB128 number per event: samples since the previous event
+ * (the first one counts from 0). Events alternate key-down, key-up,
+ * starting with key-down.
+ */
+#define EVENTS_MAGIC "TTMK"
+
+/* longest pattern in morse_alphabet */
+#define EVENTS_MAX_ELEMENTS (16)
+
+int events_format(const char *name);
+int events_file(FILE *input, char *output, int wpm, int fwpm, int format);
+int events_buffer(const unsigned char *text, size_t len, char *output, int wpm, int fwpm, int format);
+
+#endif
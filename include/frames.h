@@ -0,0 +1,61 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_FRAMES_H
+#define TEXT_TO_MORSE_FRAMES_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* longest frame header growth when renumbering (1 byte to 7 byte number) */
+#define FRAMES_MAX_GROWTH (6)
+
+/* where an encoded FLAC frame lives and which samples it holds */
+struct frame {
+	uint64_t offset;	/* in the file, or in `data` of an in-memory list */
+	uint32_t bytes;
+	uint64_t sample;	/* first sample */
+	uint32_t samples;
+};
+
+struct frame_list {
+	struct frame *frames;
+	size_t len;
+	size_t cap;
+	unsigned char *data;	/* frame bytes, in-memory lists only */
+	size_t data_len;
+	size_t data_cap;
+};
+
+void frames_add(struct frame_list *l, uint64_t offset, uint32_t bytes, uint64_t sample, uint32_t samples);
+void frames_add_data(struct frame_list *l, const unsigned char *data, size_t bytes, uint32_t samples);
+void frames_free(struct frame_list *l);
+
+size_t frames_renumber(unsigned char *dst, const unsigned char *src, size_t len, uint64_t sample);
+int frames_scan(const unsigned char *data, size_t len, struct frame_list *l);
+
+/* writes a variable block size FLAC stream out of already encoded frames */
+struct flacstream;
+
+struct flacstream *flacstream_open(char *filepath, uint64_t total_samples, int seek_interval, char *app_id, unsigned char *app_data, size_t app_len);
+int flacstream_frame(struct flacstream *fs, const unsigned char *frame, size_t len, uint32_t samples);
+int flacstream_close(struct flacstream *fs, const unsigned char md5[16], struct frame_list *frames);
+
+#endif
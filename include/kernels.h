@@ -0,0 +1,50 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_KERNELS_H
+#define TEXT_TO_MORSE_KERNELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* instruction sets the kernels come in, slowest first */
+#define KERNELS_SCALAR (0)
+#define KERNELS_SSE2 (1)
+#define KERNELS_AVX2 (2)
+#define KERNELS_AVX512 (3)
+#define KERNELS_LEVELS (4)
+
+/* the phasor oscillator: lanes rotated side by side, see tone.c */
+#define KERNELS_TONE_LANES (4)
+
+/* the hot sample loops; every level gives exactly the scalar results */
+struct kernels {
+	const char *name;
+	void (*widen)(int32_t *dst, const int16_t *src, size_t n);
+	void (*copy)(int16_t *dst, const int16_t *src, size_t n);
+	void (*zero)(int16_t *dst, size_t n);
+	void (*phasor)(int16_t *dst, size_t n, double re[KERNELS_TONE_LANES], double im[KERNELS_TONE_LANES], double step_re, double step_im, double volume);
+};
+
+const struct kernels *kernels_get(void);
+const struct kernels *kernels_level(int level);
+
+#endif
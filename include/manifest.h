@@ -0,0 +1,47 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_MANIFEST_H
+#define TEXT_TO_MORSE_MANIFEST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "frames.h"
+
+#define MANIFEST_VERSION (2)
+
+/* what went into an output file and where each of its frames is */
+struct manifest {
+	int wpm;
+	int fwpm;
+	int frequency;
+	int envelope;	/* TONE_ENVELOPE_* */
+	unsigned char *text;
+	size_t text_len;
+	uint64_t total_samples;
+	struct frame_list frames;
+};
+
+int manifest_read(char *filepath, struct manifest *m);
+int manifest_write(char *filepath, struct manifest *m);
+void manifest_free(struct manifest *m);
+
+#endif
@@ -0,0 +1,38 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_MD5_H
+#define TEXT_TO_MORSE_MD5_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct md5 {
+	uint32_t state[4];
+	uint64_t len;
+	unsigned char block[64];
+};
+
+void md5_init(struct md5 *ctx);
+void md5_update(struct md5 *ctx, const void *data, size_t len);
+void md5_update_samples(struct md5 *ctx, const int16_t *samples, size_t nsamples);
+void md5_final(struct md5 *ctx, unsigned char digest[16]);
+
+#endif
@@ -0,0 +1,37 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_MEASURE_H
+#define TEXT_TO_MORSE_MEASURE_H
+
+#include <stdlib.h>
+
+/* number of samples each input byte renders to, given the element lengths */
+struct measure {
+	size_t inter_character;
+	size_t character[256];	/* excludes the inter-character space before it */
+	size_t tone[256];	/* part of character[] that is dits and dahs */
+};
+
+void measure_init(struct measure *m, size_t dit, size_t dah, size_t intra_character, size_t inter_character, size_t inter_word);
+size_t measure_text(const struct measure *m, const unsigned char *text, size_t len, size_t first);
+size_t measure_tone(const struct measure *m, const unsigned char *text, size_t len);
+
+#endif
@@ -0,0 +1,40 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_NORMALIZE_H
+#define TEXT_TO_MORSE_NORMALIZE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* what normalize() remembers between chunks of the same input */
+struct normalize {
+	int started;	/* something has been written */
+	int pending;	/* whitespace run waiting for the next symbol: 0, ' ' or '\n' */
+};
+
+int normalize_enable(int substitute);
+int normalize_is_enabled(void);
+void normalize_init(struct normalize *st);
+size_t normalize(struct normalize *st, unsigned char *dst, const unsigned char *src, size_t len);
+size_t normalize_fread(struct normalize *st, unsigned char *dst, size_t cap, FILE *input);
+
+#endif
@@ -0,0 +1,43 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_NPY_H
+#define TEXT_TO_MORSE_NPY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* sample types of the audio array */
+#define NPY_FLOAT32 (0)		/* .npy: -1.0 to 1.0 */
+#define NPY_INT16 (1)		/* .i16.npy */
+
+/* kinds of label records */
+#define NPY_LABEL_CHARACTER (0)
+#define NPY_LABEL_DIT (1)
+#define NPY_LABEL_DAH (2)
+
+/* arrays start at a multiple of this in the file, so they can be mapped and used in place */
+#define NPY_ALIGN (64)
+
+int npy_write(char *filepath, const int16_t *samples, size_t len, int format);
+int npy_write_labels(char *filepath, const unsigned char *text, size_t len, int wpm, int fwpm);
+
+#endif
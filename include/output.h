@@ -0,0 +1,45 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXT_TO_MORSE_OUTPUT_H
+#define TEXT_TO_MORSE_OUTPUT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* output settings - 64 KiB write buffers, up to 64 in flight with io_uring */
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+#define OUTPUT_QUEUE_DEPTH (64)
+
+struct output;
+
+void output_set_queue_depth(int depth);
+int output_get_queue_depth(void);
+int output_uring_available(void);
+
+char *output_name(const char *filepath, const char *suffix, const char *ext);
+int output_is_descriptor(const char *filepath);
+struct output *output_open(char *filepath);
+int output_write(struct output *out, const void *data, size_t len);
+int output_seek(struct output *out, uint64_t offset);
+uint64_t output_tell(struct output *out);
+int output_close(struct output *out);
+
+#endif
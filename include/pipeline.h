@@ -0,0 +1,42 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_PIPELINE_H
+#define TEXT_TO_MORSE_PIPELINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* blocks in flight between two stages (a power of two) and their sizes */
+#define PIPELINE_DEPTH (16)
+#define PIPELINE_TEXT_BLOCK (4096)	/* bytes of input */
+#define PIPELINE_SAMPLE_BLOCK (4096)	/* samples, the FLAC block size at level 8 */
+
+/* what pipeline_run() produced */
+struct pipeline_stats {
+	size_t text_len;
+	size_t total_samples;
+	int verified;		/* 1 passed, -1 failed, 0 not verified */
+};
+
+int pipeline_run(FILE *input, char *filepath, struct pipeline_stats *stats);
+
+#endif
@@ -0,0 +1,49 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_PRESETS_H
+#define TEXT_TO_MORSE_PRESETS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Waveforms rendered at build time (tools/presets.c) for the settings in
+ * the TEXT_TO_MORSE_PRESETS cmake variable, kept in read-only data.
+ */
+struct preset {
+	int wpm;
+	int frequency;
+	const int16_t *dit;
+	size_t dit_len;
+	const int16_t *dah;
+	size_t dah_len;
+};
+
+/* generated */
+extern const struct preset presets[];
+extern const size_t presets_len;
+extern const int16_t presets_silence[];	/* long enough for the spaces of every preset */
+extern const size_t presets_silence_len;
+
+const struct preset *presets_find(int wpm, int frequency);
+
+#endif
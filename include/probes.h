@@ -0,0 +1,63 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_PROBES_H
+#define TEXT_TO_MORSE_PROBES_H
+
+/*
+ * USDT (SystemTap/DTrace style) static probes, provider text_to_morse.
+ * Built in when <sys/sdt.h> is found (systemtap-sdt-dev or
+ * systemtap-sdt-devel). A probe nobody is attached to is a single nop
+ * (its arguments are values already at hand), so they stay in release
+ * builds. Without the header the macros compile to nothing. List them with
+ * `bpftrace -l 'usdt:./text-to-morse:*'`.
+ *
+ *   element_init_start(kind, wpm, arg)		kind 0 tone (arg: frequency), 1 space (arg: fwpm)
+ *   element_init_done(kind, wpm, arg, source)	source 0 preset, 1 shared cache, 2 rendered
+ *   character(c, position, nsamples)		input byte at `position` rendered
+ *   buffer_grow(old_samples, new_samples)	render buffer realloc
+ *   block_submit(samples)			samples handed to libFLAC
+ *   block_done(samples)				libFLAC done with them
+ *   frame_write(frame, bytes, samples)		an encoded frame leaving the encoder
+ */
+
+#define PROBE_ELEMENT_TONE (0)
+#define PROBE_ELEMENT_SPACE (1)
+
+#define PROBE_SOURCE_PRESET (0)
+#define PROBE_SOURCE_SHARED (1)
+#define PROBE_SOURCE_RENDERED (2)
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define PROBE1(name, a)			DTRACE_PROBE1(text_to_morse, name, a)
+#define PROBE2(name, a, b)		DTRACE_PROBE2(text_to_morse, name, a, b)
+#define PROBE3(name, a, b, c)		DTRACE_PROBE3(text_to_morse, name, a, b, c)
+#define PROBE4(name, a, b, c, d)	DTRACE_PROBE4(text_to_morse, name, a, b, c, d)
+#else
+/* sizeof() keeps the arguments "used" without evaluating them */
+#define PROBE1(name, a)			do { (void) sizeof(a); } while (0)
+#define PROBE2(name, a, b)		do { (void) sizeof(a); (void) sizeof(b); } while (0)
+#define PROBE3(name, a, b, c)		do { (void) sizeof(a); (void) sizeof(b); (void) sizeof(c); } while (0)
+#define PROBE4(name, a, b, c, d)	do { (void) sizeof(a); (void) sizeof(b); (void) sizeof(c); (void) sizeof(d); } while (0)
+#endif
+
+#endif
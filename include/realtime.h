@@ -0,0 +1,50 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_REALTIME_H
+#define TEXT_TO_MORSE_REALTIME_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define REALTIME_BLOCK (160)		/* samples written at a time, 20 ms */
+#define REALTIME_TEXT (256)		/* bytes of input read at a time */
+#define REALTIME_AHEAD (10 * 8000)	/* samples the reader may render ahead of the writer */
+#define REALTIME_MARKS (64)		/* text reads waiting for their latency to be measured */
+
+/* what realtime_run() measured; times in microseconds */
+struct realtime_stats {
+	size_t samples;		/* written, including silence while waiting for text */
+	size_t underruns;	/* writes later than the buffer allows */
+	size_t latency_count;
+	size_t latency_unmeasured;	/* reads past REALTIME_MARKS waiting at once, not in the latency */
+	uint64_t latency_min;	/* text read to its first sample being played */
+	uint64_t latency_sum;
+	uint64_t latency_max;
+	size_t jitter_count;
+	uint64_t jitter_sum;	/* how late the writer woke up */
+	uint64_t jitter_max;
+};
+
+int realtime_run(FILE *input, char *filepath, int buffer_ms, struct realtime_stats *stats);
+
+#endif
@@ -21,9 +21,28 @@
 #ifndef TEXT_TO_MORSE_RENDER_H
 #define TEXT_TO_MORSE_RENDER_H
 
+#include <stdint.h>
 #include <stdio.h>
 
+#include "measure.h"
+
+/* a set of element waveforms, for rendering with other settings than tone_init() and space_init()'s */
+struct elements {
+	const int16_t *dit;		size_t dit_len;
+	const int16_t *dah;		size_t dah_len;
+	const int16_t *intra_character;	size_t intra_character_len;
+	const int16_t *inter_character;	size_t inter_character_len;
+	const int16_t *inter_word;	size_t inter_word_len;
+};
+
 void render_text(FILE *input);
+void render_text_parallel(FILE *input, int jobs);
+void render_span(int16_t *dst, const unsigned char *text, size_t len, size_t first);
+void render_span_elements(const struct elements *e, int16_t *dst, const unsigned char *text, size_t len, size_t first);
+void render_elements(struct elements *e);
+void render_buffer(const unsigned char *text, size_t len, int jobs);
+unsigned char *render_read(FILE *input, size_t *len);
+void render_measure(struct measure *m);
 void render_exit(void);
 
 int16_t *render_get_buf(void);
@@ -0,0 +1,34 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_REPEAT_H
+#define TEXT_TO_MORSE_REPEAT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* most repetitions and longest gap (in seconds) between them */
+#define REPEAT_MAX (1000000)
+#define REPEAT_MAX_GAP (3600)
+
+int repeat_encode(char *filepath, const int16_t *samples, size_t nsamples, size_t gap, size_t count, int seek_interval, int *verified);
+
+#endif
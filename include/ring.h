@@ -0,0 +1,57 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_RING_H
+#define TEXT_TO_MORSE_RING_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* keep the producer's and the consumer's index on separate cache lines */
+#define RING_CACHE_LINE (64)
+
+/* times ring_put()/ring_get() yield before they sleep until the other side moves */
+#define RING_SPINS (64)
+
+/*
+ * Bounded single-producer/single-consumer queue of pointers. Exactly one
+ * thread may put and exactly one thread may get; no locks are taken
+ * unless one side has to wait for the other.
+ */
+struct ring {
+	_Alignas(RING_CACHE_LINE) atomic_size_t head;	/* next slot to get, written by the consumer */
+	_Alignas(RING_CACHE_LINE) atomic_size_t tail;	/* next slot to put, written by the producer */
+	_Alignas(RING_CACHE_LINE) void **slots;
+	size_t mask;
+	atomic_int waiting;	/* threads asleep in ring_wait() */
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+};
+
+int ring_init(struct ring *r, size_t size);
+int ring_try_put(struct ring *r, void *p);
+void *ring_try_get(struct ring *r);
+void ring_put(struct ring *r, void *p);
+void *ring_get(struct ring *r);
+void ring_exit(struct ring *r);
+
+#endif
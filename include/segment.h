@@ -0,0 +1,49 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_SEGMENT_H
+#define TEXT_TO_MORSE_SEGMENT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "measure.h"
+
+/* a word boundary this far (as a fraction of the target) from the target wins over a character boundary */
+#define SEGMENT_WORD_WINDOW (0.5)
+
+/* a piece of the output, written to its own file */
+struct segment {
+	char *filepath;
+	size_t first_byte;
+	size_t bytes;
+	size_t first_sample;
+	size_t samples;
+	int rc;
+	int verified;
+};
+
+struct segment *segment_plan(const unsigned char *text, size_t len, const struct measure *m, size_t target, size_t *nsegments);
+int segment_encode(char *filepath, const int16_t *samples, struct segment *segments, size_t nsegments, int jobs, int *verified);
+int segment_write_manifest(char *filepath, struct segment *segments, size_t nsegments);
+void segment_free(struct segment *segments, size_t nsegments);
+
+#endif
@@ -0,0 +1,61 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_SHARD_H
+#define TEXT_TO_MORSE_SHARD_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* shard index file layout, see shard.c */
+#define SHARD_MAGIC "TTMSHARD"
+#define SHARD_VERSION (1)
+#define SHARD_HEADER_SIZE (32)
+#define SHARD_RECORD_SIZE (40)
+
+/* shard size limits, in MiB */
+#define SHARD_MIN_MB (1)
+#define SHARD_MAX_MB (1048576)
+#define SHARD_DEFAULT_MB (256)
+
+/* where one clip is and what went into it */
+struct shard_clip {
+	uint64_t offset;	/* in its shard */
+	uint64_t samples;
+	uint64_t text_offset;	/* in the index's text (in the input, while packing) */
+	uint32_t bytes;
+	uint32_t text_len;
+	uint32_t shard;
+	int frequency;
+	int wpm;
+	int fwpm;
+};
+
+struct shard_stats {
+	size_t clips;
+	size_t shards;
+	int verified;
+};
+
+int shard_pack(const unsigned char *text, size_t len, char *filepath, uint64_t shard_size, int wpm, int fwpm, int frequency, int jobs, struct shard_stats *stats);
+int shard_extract(char *filepath, uint64_t clip, char *output, int seek_interval, int verbose);
+
+#endif
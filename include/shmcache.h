@@ -0,0 +1,44 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_SHMCACHE_H
+#define TEXT_TO_MORSE_SHMCACHE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* bump when the layout or the waveforms change, so old entries aren't used */
+#define SHMCACHE_VERSION (2)
+
+/* entry names are /text-to-morse-VERSION-UID-RATE-KEY */
+#define SHMCACHE_PREFIX "/text-to-morse"
+
+/* how long to wait for another process to finish building an entry */
+#define SHMCACHE_WAIT_MS (2000)
+
+void shmcache_enable(void);
+int shmcache_is_enabled(void);
+
+int16_t *shmcache_open(const char *key, size_t nsamples, int *build);
+const int16_t *shmcache_ready(int16_t *samples);
+void shmcache_close(const int16_t *samples);
+
+#endif
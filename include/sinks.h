@@ -0,0 +1,41 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_SINKS_H
+#define TEXT_TO_MORSE_SINKS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* kinds of extra outputs, picked by file name extension */
+#define SINK_FLAC (0)	/* .flac */
+#define SINK_WAV (1)	/* .wav */
+#define SINK_RAW (2)	/* .raw .pcm: 16-bit little-endian mono */
+#define SINK_EVENTS (3)	/* .csv .json .keys: key events, see events.h */
+#define SINK_NPY (4)	/* .npy: float32 (or .i16.npy int16) array and labels, see npy.h */
+
+int sinks_add(char *filepath);
+size_t sinks_len(void);
+void sinks_start(const int16_t *samples, size_t nsamples, const unsigned char *text, size_t text_len, int wpm, int fwpm);
+int sinks_wait(void);
+void sinks_exit(void);
+
+#endif
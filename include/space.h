@@ -21,11 +21,14 @@
 #ifndef TEXT_TO_MORSE_SPACE_H
 #define TEXT_TO_MORSE_SPACE_H
 
-int16_t *space_get_inter_character(void);
+#include <stdint.h>
+#include <stdlib.h>
+
+const int16_t *space_get_inter_character(void);
 size_t space_get_inter_character_len(void);
-int16_t *space_get_intra_character(void);
+const int16_t *space_get_intra_character(void);
 size_t space_get_intra_character_len(void);
-int16_t *space_get_inter_word_space(void);
+const int16_t *space_get_inter_word_space(void);
 size_t space_get_inter_word_len(void);
 
 int space_init(int wpm, int fwpm);
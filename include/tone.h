@@ -22,10 +22,21 @@
 #define TEXT_TO_MORSE_TONE_H
 
 #include <stdint.h>
+#include <stdlib.h>
 
-int16_t *tone_get_dit(void);
+/* shapes of the rise and fall of each tone */
+#define TONE_ENVELOPE_LINEAR (0)
+#define TONE_ENVELOPE_COSINE (1)	/* raised cosine */
+
+/* how often the oscillator's phasors restart from sin()/cos(), a multiple of KERNELS_TONE_LANES */
+#define TONE_RESYNC (1024)
+
+void tone_set_envelope(int envelope);
+int tone_get_envelope(void);
+int tone_envelope_parse(const char *name);
+const int16_t *tone_get_dit(void);
 size_t tone_get_dit_len(void);
-int16_t *tone_get_dah(void);
+const int16_t *tone_get_dah(void);
 size_t tone_get_dah_len(void);
 int tone_init(int wpm, int frequency);
 void tone_exit(void);
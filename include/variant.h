@@ -0,0 +1,51 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_VARIANT_H
+#define TEXT_TO_MORSE_VARIANT_H
+
+#include <stdlib.h>
+
+#include "measure.h"
+#include "render.h"
+
+/* most variants in one run */
+#define VARIANT_MAX (256)
+
+/* one speed and pitch to render the text at, and where it goes */
+struct variant {
+	int wpm;
+	int fwpm;
+	int frequency;
+	char *filepath;
+	struct elements e;	/* private copies of the waveforms */
+	struct measure m;
+	size_t samples;
+	int rc;
+	int verified;
+};
+
+struct variant *variant_parse(const char *spec, int frequency, size_t *nvariants);
+int variant_init(char *filepath, struct variant *variants, size_t nvariants);
+int variant_encode(const unsigned char *text, size_t len, struct variant *variants, size_t nvariants, int jobs, int *verified);
+void variant_free(struct variant *variants, size_t nvariants);
+
+#endif
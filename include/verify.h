@@ -0,0 +1,52 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_VERIFY_H
+#define TEXT_TO_MORSE_VERIFY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "frames.h"
+
+/* exit status when the output doesn't decode back to the rendered audio */
+#define VERIFY_EXIT_FAILURE (2)
+
+/* encoded bytes waiting for the verify decoder before the encoder waits for it */
+#define VERIFY_QUEUE_BYTES (4 * 1024 * 1024)
+
+/* largest block a FLAC frame can hold */
+#define VERIFY_MAX_BLOCKSIZE (65535)
+
+struct verify;
+
+void verify_set_enabled(int enabled);
+int verify_is_enabled(void);
+
+struct verify *verify_start(const int16_t *samples, size_t nsamples);
+int verify_feed(struct verify *v, const unsigned char *data, size_t len);
+void verify_output(struct verify *v, const char *filepath, const struct frame_list *frames);
+int verify_finish(struct verify *v);
+int verify_finish_digest(struct verify *v, const unsigned char expected[16], size_t nsamples);
+int verify_file(char *filepath, const int16_t *samples, size_t nsamples);
+int verify_frames(const int16_t *samples, size_t nsamples, const struct frame_list *l);
+
+#endif
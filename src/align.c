@@ -0,0 +1,138 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "align.h"
+#include "bytes.h"
+#include "encoder.h"
+#include "morse.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* index of word and line starts, filled in by the renderer */
+static int enabled = 0;
+static struct align_mark *marks = NULL;
+static size_t marks_len = 0;
+static size_t marks_cap = 0;
+
+/* scanner state: next visible character starts a word / a line */
+static int at_word = 1;
+static int at_line = 1;
+
+void align_enable(void)			{ enabled = 1; }
+int align_is_enabled(void)		{ return enabled; }
+struct align_mark *align_get_marks(void) { return marks; }
+size_t align_get_marks_len(void)	{ return marks_len; }
+
+static void align_add(uint64_t byte, uint64_t sample, int kind) {
+	struct align_mark *new_marks;
+
+	if (marks_len == marks_cap) {
+		marks_cap = marks_cap == 0 ? 1024 : marks_cap * 2;
+		new_marks = (struct align_mark *) realloc(marks, marks_cap * sizeof(struct align_mark));
+		if (new_marks == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+		marks = new_marks;
+	}
+
+	marks[marks_len].byte = byte;
+	marks[marks_len].sample = sample;
+	marks[marks_len].kind = kind;
+	marks_len++;
+}
+
+/*
+ * Called for every input byte, in order, with the sample where that byte's
+ * own samples start (after the inter-character space before it). Bytes
+ * without a morse mapping neither start nor end a word.
+ */
+void align_char(unsigned char c, uint64_t byte, uint64_t sample) {
+	const char *s = morse_alphabet[c];
+
+	if (c == '\n') {
+		at_line = at_word = 1;
+	} else if (s[0] == ' ') {
+		at_word = 1;
+	} else if (s[0] != '\0') {
+		if (at_line) {
+			align_add(byte, sample, ALIGN_WORD | ALIGN_LINE);
+		} else if (at_word) {
+			align_add(byte, sample, ALIGN_WORD);
+		}
+		at_line = at_word = 0;
+	}
+}
+
+/*
+ * Pack the index for a FLAC APPLICATION block. Big endian like the rest of
+ * FLAC: a 32-bit count followed by (u64 byte, u64 sample, u8 kind) entries.
+ */
+unsigned char *align_serialize(size_t *len) {
+	unsigned char *data;
+	unsigned char *p;
+	size_t i;
+
+	*len = 4 + marks_len * 17;
+	data = (unsigned char *) malloc(*len);
+	if (data == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bytes_put_be(data, marks_len, 4);
+	p = data + 4;
+	for (i = 0; i < marks_len; i++) {
+		bytes_put_be(p, marks[i].byte, 8);
+		bytes_put_be(p + 8, marks[i].sample, 8);
+		p[16] = marks[i].kind;
+		p += 17;
+	}
+
+	return data;
+}
+
+/* write the index as text: byte offset, sample offset, seconds, kind */
+int align_write(char *filepath) {
+	FILE *out;
+	size_t i;
+
+	out = fopen(filepath, "w");
+	if (out == NULL) {
+		return -1;
+	}
+
+	for (i = 0; i < marks_len; i++) {
+		fprintf(out, "%" PRIu64 "\t%" PRIu64 "\t%.3f\t%s\n", marks[i].byte, marks[i].sample,
+			(double) marks[i].sample / SAMPLE_RATE, (marks[i].kind & ALIGN_LINE) ? "line" : "word");
+	}
+
+	return fclose(out) == 0 ? 0 : -1;
+}
+
+void align_exit(void) {
+	free(marks);
+	marks = NULL;
+	marks_len = marks_cap = 0;
+	at_word = at_line = 1;
+}
@@ -0,0 +1,63 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bytes.h"
+
+#include <stdint.h>
+
+void bytes_put_le(unsigned char *p, uint64_t v, int bytes) {
+	int i;
+
+	for (i = 0; i < bytes; i++) {
+		p[i] = v & 0xff;
+		v >>= 8;
+	}
+}
+
+uint64_t bytes_get_le(const unsigned char *p, int bytes) {
+	uint64_t v = 0;
+	int i;
+
+	for (i = bytes - 1; i >= 0; i--) {
+		v = (v << 8) | p[i];
+	}
+
+	return v;
+}
+
+void bytes_put_be(unsigned char *p, uint64_t v, int bytes) {
+	int i;
+
+	for (i = bytes - 1; i >= 0; i--) {
+		p[i] = v & 0xff;
+		v >>= 8;
+	}
+}
+
+uint64_t bytes_get_be(const unsigned char *p, int bytes) {
+	uint64_t v = 0;
+	int i;
+
+	for (i = 0; i < bytes; i++) {
+		v = (v << 8) | p[i];
+	}
+
+	return v;
+}
@@ -0,0 +1,686 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Turns morse audio back into text. A Goertzel filter tuned to the tone
+ * measures the power of every short block of samples; blocks above a
+ * threshold are key-down. The key-down/key-up run lengths are classified
+ * against a unit length that is estimated up front and then tracked as
+ * the decode goes on, so speed changes are followed.
+ */
+
+#include "decode.h"
+#include "morse.h"
+#include "wav.h"
+#include "work.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <FLAC/stream_decoder.h>
+
+/* key-down or key-up for `len` samples */
+struct decode_run {
+	int on;
+	size_t len;
+};
+
+/* growable sample buffer filled by the FLAC decoder */
+struct decode_pcm {
+	int16_t *samples;
+	size_t len;
+	size_t cap;
+	int rate;
+};
+
+static void *decode_grow(void *p, size_t *cap, size_t need, size_t size) {
+	void *new_p;
+	size_t new_cap = *cap == 0 ? 4096 : *cap;
+
+	if (need <= *cap) {
+		return p;
+	}
+	while (new_cap < need) {
+		new_cap *= 2;
+	}
+	new_p = realloc(p, new_cap * size);
+	if (new_p == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	*cap = new_cap;
+
+	return new_p;
+}
+
+/* power of `n` samples at the frequency given by `coeff` = 2cos(2*pi*f/rate) */
+static double decode_goertzel(const int16_t *x, size_t n, double coeff) {
+	double s0, s1 = 0.0, s2 = 0.0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		s0 = x[i] + coeff * s1 - s2;
+		s2 = s1;
+		s1 = s0;
+	}
+
+	return s1 * s1 + s2 * s2 - coeff * s1 * s2;
+}
+
+static double decode_coeff(int frequency, int rate) {
+	return 2.0 * cos(2.0 * M_PI * frequency / rate);
+}
+
+/* total power at `frequency` over `n` samples taken `block` at a time */
+static double decode_power(const int16_t *samples, size_t n, size_t block, int frequency, int rate) {
+	double coeff = decode_coeff(frequency, rate);
+	double power = 0.0;
+	size_t i;
+
+	for (i = 0; i + block <= n; i += block) {
+		power += decode_goertzel(samples + i, block, coeff);
+	}
+
+	return power;
+}
+
+/*
+ * Find the tone in the first 30 seconds: the candidate frequency with the
+ * most energy over long blocks, which keep neighbouring signals apart,
+ * then the exact frequency within a step of it over short blocks. Fast
+ * keying puts sidebands on the tone that the long blocks resolve, so
+ * their peak can be off by most of a step.
+ */
+static int decode_find_frequency(const int16_t *samples, size_t len, int rate) {
+	size_t n = len < (size_t) rate * 30 ? len : (size_t) rate * 30;
+	size_t search = n < DECODE_SEARCH_BLOCK ? n : DECODE_SEARCH_BLOCK;
+	size_t refine = n < DECODE_REFINE_BLOCK ? n : DECODE_REFINE_BLOCK;
+	double best_power = -1.0;
+	double power[2 * DECODE_FREQUENCY_STEP + 1];
+	int best = 0;
+	int coarse;
+	int f, k;
+
+	if (n == 0) {
+		return 0;
+	}
+
+	for (f = DECODE_MIN_FREQUENCY; f <= DECODE_MAX_FREQUENCY && f < rate / 2; f += DECODE_FREQUENCY_STEP) {
+		power[0] = decode_power(samples, n, search, f, rate);
+		if (power[0] > best_power) {
+			best_power = power[0];
+			best = f;
+		}
+	}
+
+	coarse = best;
+	for (k = 0; k <= 2 * DECODE_FREQUENCY_STEP; k++) {
+		f = coarse - DECODE_FREQUENCY_STEP + k;
+		power[k] = f > 0 && f < rate / 2 ? decode_power(samples, n, refine, f, rate) : 0.0;
+		if (power[k] > power[best - coarse + DECODE_FREQUENCY_STEP]) {
+			best = f;
+		}
+	}
+
+	/* between whole Hz: the top of a parabola through the peak and its neighbours */
+	k = best - coarse + DECODE_FREQUENCY_STEP;
+	if (k > 0 && k < 2 * DECODE_FREQUENCY_STEP) {
+		double d = power[k - 1] - 2.0 * power[k] + power[k + 1];
+
+		if (d < 0.0) {
+			return (int) floor(best + 0.5 * (power[k - 1] - power[k + 1]) / d + 0.5);
+		}
+	}
+
+	return best;
+}
+
+static int decode_cmp_double(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+/* split `v` into a short and a long group, returning the boundary */
+static double decode_split(const size_t *v, size_t n) {
+	double lo, hi, lo_sum, hi_sum, mid;
+	size_t lo_n, hi_n, i;
+	int iter;
+
+	lo = hi = v[0];
+	for (i = 0; i < n; i++) {
+		lo = v[i] < lo ? v[i] : lo;
+		hi = v[i] > hi ? v[i] : hi;
+	}
+
+	for (iter = 0; iter < 16; iter++) {
+		mid = (lo + hi) / 2.0;
+		lo_sum = hi_sum = 0.0;
+		lo_n = hi_n = 0;
+		for (i = 0; i < n; i++) {
+			if (v[i] < mid) {
+				lo_sum += v[i];
+				lo_n++;
+			} else {
+				hi_sum += v[i];
+				hi_n++;
+			}
+		}
+		lo = lo_n > 0 ? lo_sum / lo_n : lo;
+		hi = hi_n > 0 ? hi_sum / hi_n : hi;
+	}
+
+	/* one group only: no boundary */
+	return hi < lo * 1.7 ? 0.0 : (lo + hi) / 2.0;
+}
+
+static int decode_cmp_size(const void *a, const void *b) {
+	size_t x = *(const size_t *) a, y = *(const size_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+/* typical length of the shortest kind of run in `v` (reordered): the mean of those near its 10th percentile */
+static double decode_shortest(size_t *v, size_t n) {
+	double p, sum = 0.0;
+	size_t count = 0;
+	size_t i;
+
+	qsort(v, n, sizeof(size_t), decode_cmp_size);
+	p = v[(n - 1) / 10];
+	for (i = 0; i < n; i++) {
+		if (v[i] >= p * 0.75 && v[i] <= p * 1.4) {
+			sum += v[i];
+			count++;
+		}
+	}
+
+	return sum / count;
+}
+
+/*
+ * Unit length from key-down runs that are a mix of dits and dahs, 0 if
+ * they're all alike. A dah is three units and a dit one, so the difference
+ * of the two is two units whatever the detector does to the edges; how far
+ * the dits fall short of a unit is how much every key-down run is cut
+ * short (and every key-up run stretched) by the rise and fall of the tone.
+ */
+static double decode_unit(const size_t *v, size_t n, double *bias) {
+	double boundary = n > 0 ? decode_split(v, n) : 0.0;
+	double dit = 0.0, dah = 0.0;
+	size_t dits = 0, dahs = 0;
+	double unit;
+	size_t i;
+
+	*bias = 0.0;
+	if (boundary == 0.0) {
+		return 0.0;
+	}
+	for (i = 0; i < n; i++) {
+		if (v[i] < boundary) {
+			dit += v[i];
+			dits++;
+		} else {
+			dah += v[i];
+			dahs++;
+		}
+	}
+	dit /= dits;
+	dah /= dahs;
+	if (dah < dit * 2.5) {
+		return 0.0;	/* two lengths, but not a dit and a dah: the edges of one kind of element wander */
+	}
+
+	unit = (dah - dit) / 2.0;
+	*bias = unit - dit;
+	*bias = *bias > unit / 2.0 ? unit / 2.0 : *bias < -unit / 2.0 ? -unit / 2.0 : *bias;
+
+	return unit;
+}
+
+/* pattern of dits (0) and dahs (1) with a leading 1 bit => character */
+static char decode_table[256];
+static pthread_once_t decode_table_once = PTHREAD_ONCE_INIT;
+
+static void decode_table_init(void) {
+	int c;
+	int i;
+
+	for (c = 0; c < 256; c++) {
+		const char *s = morse_alphabet[c];
+		int code = 1;
+
+		if (s[0] == '\0' || s[0] == ' ' || islower(c)) {
+			continue;
+		}
+		for (i = 0; s[i] != '\0' && code < 128; i++) {
+			code = code * 2 + (s[i] == '-');
+		}
+		if (code < 256 && decode_table[code] == '\0') {
+			decode_table[code] = c;
+		}
+	}
+}
+
+/*
+ * Decode `len` samples at `rate` Hz. `frequency` is the tone to listen
+ * for, 0 to find it. Returns the text (malloc'd, NUL terminated).
+ */
+char *decode_samples(int16_t *samples, size_t len, int rate, int frequency, struct decode_stats *stats) {
+	size_t block = rate * DECODE_BLOCK_MS / 1000;
+	size_t nblocks = block > 0 ? len / block : 0;
+	double *power = NULL;
+	double *sorted = NULL;
+	double coeff, peak, threshold;
+	struct decode_run *runs = NULL;
+	size_t nruns = 0, runs_cap = 0;
+	double *edges;
+	size_t r;
+	size_t *lens = NULL;
+	size_t nlens;
+	size_t i;
+	double unit, bias, word_gap;
+	char *text = NULL;
+	size_t text_len = 0, text_cap = 0;
+	int code = 1;
+
+	pthread_once(&decode_table_once, decode_table_init);
+	memset(stats, 0, sizeof(struct decode_stats));
+
+	if (frequency == 0) {
+		frequency = decode_find_frequency(samples, len, rate);
+	}
+	stats->frequency = frequency;
+
+	text = (char *) decode_grow(text, &text_cap, 1, 1);
+	text[0] = '\0';
+	if (nblocks == 0 || frequency == 0) {
+		return text;
+	}
+
+	/* narrowband power of every block */
+	coeff = decode_coeff(frequency, rate);
+	power = (double *) malloc(nblocks * sizeof(double));
+	sorted = (double *) malloc(nblocks * sizeof(double));
+	lens = (size_t *) malloc((nblocks + 1) * sizeof(size_t));
+	if (power == NULL || sorted == NULL || lens == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < nblocks; i++) {
+		power[i] = sorted[i] = decode_goertzel(samples + i * block, block, coeff);
+	}
+
+	/* key-down is anything above a quarter of the typical peak (half the amplitude) */
+	qsort(sorted, nblocks, sizeof(double), decode_cmp_double);
+	peak = sorted[(nblocks - 1) * 99 / 100];
+	threshold = peak / 4.0;
+	free(sorted);
+
+	for (i = 0; i < nblocks; i++) {
+		int on = peak > 0.0 && power[i] > threshold;
+
+		if (nruns == 0 || runs[nruns - 1].on != on) {
+			runs = (struct decode_run *) decode_grow(runs, &runs_cap, nruns + 1, sizeof(struct decode_run));
+			runs[nruns].on = on;
+			runs[nruns].len = 0;
+			nruns++;
+		}
+	}
+
+	/*
+	 * Place each edge inside its block: the tone's amplitude in a block is
+	 * the fraction of the block it covers, so that much of the block goes
+	 * to the key-down side of the edge and the rest to the key-up side.
+	 * Whole blocks alone are too coarse once a dit is only a few blocks.
+	 */
+	edges = (double *) calloc(nruns, sizeof(double));
+	if (edges == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0, r = 0; i < nblocks; i++) {
+		int on = runs[r].on;
+		double tone = peak > 0.0 ? sqrt(power[i] / peak) : 0.0;
+		double own = (on ? (tone < 1.0 ? tone : 1.0) : (tone < 1.0 ? 1.0 - tone : 0.0)) * block;
+
+		edges[r] += own;
+		if (i > 0 && (power[i - 1] > threshold) != on) {
+			edges[r - 1] += block - own;	/* first block of a run */
+		} else if (i + 1 < nblocks && (power[i + 1] > threshold) != on) {
+			edges[r + 1] += block - own;	/* last block of a run */
+		} else {
+			edges[r] += block - own;
+		}
+		if (i + 1 < nblocks && (power[i + 1] > threshold) != on) {
+			r++;
+		}
+	}
+	for (r = 0; r < nruns; r++) {
+		runs[r].len = edges[r] > 1.0 ? (size_t) (edges[r] + 0.5) : 1;
+	}
+	free(edges);
+	free(power);
+
+	/* drop leading and trailing silence */
+	if (nruns > 0 && !runs[nruns - 1].on) {
+		nruns--;
+	}
+	if (nruns > 0 && !runs[0].on) {
+		memmove(runs, runs + 1, (nruns - 1) * sizeof(struct decode_run));
+		nruns--;
+	}
+	if (nruns == 0) {
+		free(runs);
+		free(lens);
+		return text;
+	}
+
+	/* starting unit: split key-down runs into dits and dahs (a dah is three units) */
+	nlens = 0;
+	for (i = 0; i < nruns; i++) {
+		if (runs[i].on) {
+			lens[nlens++] = runs[i].len;
+		}
+	}
+	unit = decode_unit(lens, nlens, &bias);
+	if (unit == 0.0) {
+		/*
+		 * All dits or all dahs. A key-down run and the key-up run after it
+		 * add up to a whole number of units whatever the edges do: 2 for a
+		 * dit and the gap inside a character, 4 for a dit and the gap after
+		 * a character or for a dah and the gap inside one.
+		 */
+		double on = 0.0, pair = 0.0;
+		size_t npairs = 0;
+
+		for (i = 0; i < nruns; i++) {
+			on += runs[i].on ? runs[i].len : 0;
+			if (runs[i].on && i + 1 < nruns) {
+				lens[npairs++] = runs[i].len + runs[i + 1].len;
+			}
+		}
+		on /= nlens;
+		pair = npairs > 0 ? decode_shortest(lens, npairs) : 0.0;
+
+		/* key-down runs come up short by about the rise and fall, up to half a unit at 100 wpm */
+		if (pair == 0.0) {
+			unit = on;		/* a lone element, call it a dit */
+		} else if (on < pair * 0.27) {
+			unit = pair / 4.0;	/* dits, one per character */
+		} else if (on < pair * 0.56) {
+			unit = pair / 2.0;	/* dits */
+		} else {
+			unit = pair / 4.0;	/* dahs */
+		}
+		bias = (on < unit * 2.0 ? unit : unit * 3.0) - on;
+		bias = bias > unit / 2.0 ? unit / 2.0 : bias < -unit / 2.0 ? -unit / 2.0 : bias;
+	}
+	for (i = 0; i < nruns; i++) {
+		double len = runs[i].len + (runs[i].on ? bias : -bias);
+
+		runs[i].len = len > 1.0 ? (size_t) (len + 0.5) : 1;
+	}
+
+	/* gaps between characters and between words (Farnsworth spacing stretches both) */
+	nlens = 0;
+	for (i = 0; i < nruns; i++) {
+		if (!runs[i].on && runs[i].len >= unit * 2) {
+			lens[nlens++] = runs[i].len;
+		}
+	}
+	word_gap = nlens > 0 ? decode_split(lens, nlens) : 0.0;
+	if (word_gap == 0.0) {
+		word_gap = unit * 5;
+		if (nlens > 0 && lens[0] >= unit * 5) {
+			word_gap = unit * 2; /* every gap is a word gap */
+		}
+	}
+	free(lens);
+
+	for (i = 0; i <= nruns; i++) {
+		int end_char = i == nruns || (!runs[i].on && runs[i].len >= unit * 2);
+		int end_word = i < nruns && !runs[i].on && runs[i].len >= word_gap;
+
+		if (i < nruns && runs[i].on) {
+			int dah = runs[i].len >= unit * 2;
+
+			code = code < 256 ? code * 2 + dah : code;
+			unit = unit * 0.9 + (dah ? runs[i].len / 3.0 : runs[i].len) * 0.1;
+		} else if (i < nruns && !end_char) {
+			unit = unit * 0.9 + runs[i].len * 0.1;
+		}
+
+		if (end_char && code > 1) {
+			char c = code < 256 ? decode_table[code] : '\0';
+
+			if (c == '\0') {
+				c = '#';
+				stats->unknown++;
+			}
+			text = (char *) decode_grow(text, &text_cap, text_len + 3, 1);
+			text[text_len++] = c;
+			stats->characters++;
+			code = 1;
+		}
+		if (end_word) {
+			text = (char *) decode_grow(text, &text_cap, text_len + 3, 1);
+			text[text_len++] = ' ';
+		}
+	}
+
+	text[text_len] = '\0';
+	stats->wpm = unit > 0.0 ? 1.2 * rate / unit : 0.0;
+	free(runs);
+
+	return text;
+}
+
+static FLAC__StreamDecoderWriteStatus decode_flac_write(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data) {
+	struct decode_pcm *pcm = (struct decode_pcm *) client_data;
+	int shift = (int) frame->header.bits_per_sample - 16;
+	uint32_t i;
+
+	pcm->samples = (int16_t *) decode_grow(pcm->samples, &pcm->cap, pcm->len + frame->header.blocksize, sizeof(int16_t));
+	for (i = 0; i < frame->header.blocksize; i++) {
+		pcm->samples[pcm->len++] = shift >= 0 ? buffer[0][i] >> shift : buffer[0][i] << -shift;
+	}
+	pcm->rate = frame->header.sample_rate;
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void decode_flac_error(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data) {
+	fprintf(stderr, "ERROR: decoding: %s\n", FLAC__StreamDecoderErrorStatusString[status]);
+}
+
+/* decode the first channel of a FLAC file to 16-bit samples */
+static int decode_read_flac(char *filepath, struct decode_pcm *pcm) {
+	FLAC__StreamDecoder *decoder;
+	FLAC__StreamDecoderInitStatus init_status;
+	FLAC__bool ok = true;
+
+	if ((decoder = FLAC__stream_decoder_new()) == NULL) {
+		fprintf(stderr, "ERROR: allocating decoder\n");
+		exit(EXIT_FAILURE);
+	}
+
+	init_status = FLAC__stream_decoder_init_file(decoder, filepath, decode_flac_write, NULL, decode_flac_error, pcm);
+	if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		fprintf(stderr, "ERROR: initializing decoder: %s\n", FLAC__StreamDecoderInitStatusString[init_status]);
+		ok = false;
+	}
+
+	if (ok) {
+		ok = FLAC__stream_decoder_process_until_end_of_stream(decoder);
+	}
+
+	FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+
+	return ok ? 0 : -1;
+}
+
+/* decode the FLAC or WAVE file `filepath`, NULL if it can't be read */
+static char *decode_read(char *filepath, int frequency, struct decode_stats *stats) {
+	struct decode_pcm pcm;
+	unsigned char magic[4];
+	FILE *in;
+	char *text;
+	int is_flac;
+	int rc;
+
+	in = fopen(filepath, "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Could not open input file '%s'\n", filepath);
+		return NULL;
+	}
+	is_flac = fread(magic, 1, 4, in) == 4 && memcmp(magic, "fLaC", 4) == 0;
+	fclose(in);
+
+	memset(&pcm, 0, sizeof(struct decode_pcm));
+	if (is_flac) {
+		rc = decode_read_flac(filepath, &pcm);
+	} else {
+		rc = wav_read(filepath, &pcm.samples, &pcm.len, &pcm.rate);
+	}
+	if (rc == -1 || pcm.rate <= 0) {
+		fprintf(stderr, "Could not read audio from '%s'\n", filepath);
+		free(pcm.samples);
+		return NULL;
+	}
+
+	text = decode_samples(pcm.samples, pcm.len, pcm.rate, frequency, stats);
+	free(pcm.samples);
+
+	return text;
+}
+
+/* OUTPUT/NAME.txt for the input path NAME.flac */
+static char *decode_output_name(const char *dir, const char *filepath) {
+	const char *base = strrchr(filepath, '/');
+	const char *dot;
+	char *name;
+	size_t len;
+
+	base = base == NULL ? filepath : base + 1;
+	dot = strrchr(base, '.');
+	len = dot == NULL || dot == base ? strlen(base) : (size_t) (dot - base);
+
+	name = (char *) malloc(strlen(dir) + len + 6);
+	if (name == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(name, "%s/%.*s.txt", dir, (int) len, base);
+
+	return name;
+}
+
+static int decode_write(char *text, char *output) {
+	FILE *out;
+	int rc;
+
+	out = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Could not open output file '%s'\n", output);
+		return -1;
+	}
+	fprintf(out, "%s\n", text);
+	rc = out == stdout ? fflush(out) : fclose(out);
+
+	return rc == 0 ? 0 : -1;
+}
+
+struct decode_pool {
+	struct decode_job *jobs;
+	char *dir;		/* write each text into this directory, or NULL to keep it */
+	int frequency;
+};
+
+static int decode_worker(void *arg, size_t i) {
+	struct decode_pool *pool = (struct decode_pool *) arg;
+	struct decode_job *job = &pool->jobs[i];
+
+	job->text = decode_read(job->filepath, pool->frequency, &job->stats);
+	if (job->text != NULL && pool->dir != NULL) {
+		char *output = decode_output_name(pool->dir, job->filepath);
+
+		job->rc = decode_write(job->text, output);
+		free(output);
+		free(job->text);
+		job->text = NULL;
+	} else {
+		job->rc = job->text == NULL ? -1 : 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Decode each of `n` FLAC or WAVE files on `jobs` threads. With one input
+ * the text goes to `output` ("-" for standard output). With several,
+ * `output` is either "-", which prints every text on a line after its
+ * input's name, in the order given, or a directory that gets NAME.txt for
+ * each NAME.flac or NAME.wav. `results` has room for `n` entries.
+ */
+int decode_files(char **filepaths, size_t n, char *output, int frequency, int jobs, struct decode_job *results) {
+	struct decode_pool pool;
+	struct stat st;
+	size_t i;
+	int to_dir;
+	int rc = 0;
+
+	memset(results, 0, n * sizeof(struct decode_job));
+	for (i = 0; i < n; i++) {
+		results[i].filepath = filepaths[i];
+	}
+
+	to_dir = strcmp(output, "-") != 0 && stat(output, &st) == 0 && S_ISDIR(st.st_mode);
+	if (n > 1 && strcmp(output, "-") != 0 && !to_dir) {
+		fprintf(stderr, "Decoding several files needs OUTPUT to be a directory or '-'\n");
+		return -1;
+	}
+
+	pool.jobs = results;
+	pool.dir = to_dir ? output : NULL;
+	pool.frequency = frequency;
+	work_run(n, jobs, decode_worker, &pool);
+
+	for (i = 0; i < n; i++) {
+		if (results[i].text != NULL) {
+			if (n > 1) {
+				fprintf(stdout, "%s: ", results[i].filepath);
+			}
+			if (decode_write(results[i].text, output) == -1) {
+				results[i].rc = -1;
+			}
+			free(results[i].text);
+			results[i].text = NULL;
+		}
+		rc = results[i].rc == -1 ? -1 : rc;
+	}
+
+	return rc;
+}
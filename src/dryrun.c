@@ -0,0 +1,75 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "dryrun.h"
+#include "encoder.h"
+#include "measure.h"
+#include "normalize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READSIZE (64 * 1024)
+
+/*
+ * Work out the exact number of samples `filepath` renders to, without
+ * rendering it, and estimate the size of the FLAC file. Prints one line:
+ * path, samples, seconds, estimated bytes. "-" reads standard input.
+ */
+int dryrun_file(char *filepath, const struct measure *m, int seek_interval) {
+	static unsigned char buf[READSIZE];
+	FILE *input;
+	struct normalize st;
+	size_t n;
+	size_t first = 0;
+	size_t samples = 0;
+	size_t tone = 0;
+	size_t bytes;
+
+	input = strcmp(filepath, "-") == 0 ? stdin : fopen(filepath, "r");
+	if (input == NULL) {
+		fprintf(stderr, "Could not open input file '%s'\n", filepath);
+		return -1;
+	}
+
+	normalize_init(&st);
+	while ((n = normalize_fread(&st, buf, sizeof(buf), input)) > 0) {
+		samples += measure_text(m, buf, n, first);
+		tone += measure_tone(m, buf, n);
+		first += n;
+	}
+
+	if (input != stdin) {
+		fclose(input);
+	}
+
+	/* fLaC + STREAMINFO, seek table, then the frames */
+	bytes = 4 + 38;
+	if (seek_interval > 0 && samples > 0) {
+		bytes += 4 + 18 * (samples / ((size_t) seek_interval * SAMPLE_RATE) + 1);
+	}
+	bytes += (size_t) (tone * DRYRUN_TONE_BITS / 8);
+	bytes += (samples + DRYRUN_BLOCKSIZE - 1) / DRYRUN_BLOCKSIZE * DRYRUN_FRAME_BYTES;
+
+	fprintf(stdout, "%s\t%zu\t%.3f\t%zu\n", filepath, samples, (double) samples / SAMPLE_RATE, bytes);
+
+	return 0;
+}
@@ -31,38 +31,103 @@
  */
 
 #include "encoder.h"
+#include "frames.h"
+#include "kernels.h"
+#include "output.h"
+#include "probes.h"
+#include "verify.h"
 
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <FLAC/metadata.h>
 #include <FLAC/stream_encoder.h>
 
 #define READSIZE (1024)
 
-static FLAC__byte buffer[READSIZE * (BPS/8) * CHANNELS];
-static FLAC__int32 pcm[READSIZE * CHANNELS];
+/* optional metadata blocks */
+static int seek_interval = SEEK_INTERVAL;
+static char *application_id = NULL;
+static unsigned char *application_data = NULL;
+static size_t application_len = 0;
 
-int encoder_encode(char *filepath, int16_t *result, size_t result_len, size_t total_samples) {
+void encoder_set_seek_interval(int seconds) { seek_interval = seconds; }
 
-	FILE *fin = NULL;
-	FLAC__bool ok = true;
-	FLAC__StreamEncoder *encoder = 0;
-	FLAC__StreamEncoderInitStatus init_status;
+void encoder_set_application(char *id, unsigned char *data, size_t len) {
+	application_id = id;
+	application_data = data;
+	application_len = len;
+}
 
-	fin = fmemopen(result, sizeof(int16_t) * result_len, "r");
-	if (fin == NULL) {
-		fprintf(stderr, "ERROR: could not read resulting audio\n");
-		exit(EXIT_FAILURE);
+/* an encoder writing a FLAC file through the output layer; one per thread */
+struct encoder_stream {
+	FLAC__StreamEncoder *encoder;
+	FLAC__StreamMetadata *seektable;
+	FLAC__StreamMetadata *application;
+	struct output *out;
+	char *filepath;
+	FLAC__bool ok;
+	struct frame_list frames;	/* where each frame ended up */
+	struct verify *verifier;	/* fed a copy of the stream up to the final header rewrite */
+	int verifier_fed;
+	FLAC__int32 pcm[READSIZE * CHANNELS];
+};
+
+/* route libFLAC's output through the buffered/asynchronous output layer */
+static FLAC__StreamEncoderWriteStatus encoder_write(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data) {
+	struct encoder_stream *s = (struct encoder_stream *) client_data;
+	struct frame_list *l = &s->frames;
+
+	if (samples > 0) { /* libFLAC hands over each frame in a single call */
+		uint64_t sample = l->len == 0 ? 0 : l->frames[l->len - 1].sample + l->frames[l->len - 1].samples;
+		PROBE3(frame_write, current_frame, bytes, samples);
+		frames_add(l, output_tell(s->out), bytes, sample, samples);
 	}
 
-	if ((encoder = FLAC__stream_encoder_new()) == NULL) {
-		fprintf(stderr, "ERROR: allocating encoder\n");
-		exit(EXIT_FAILURE);
+	if (s->verifier_fed && verify_feed(s->verifier, buffer, bytes) == -1) {
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+
+	return output_write(s->out, buffer, bytes) == 0 ? FLAC__STREAM_ENCODER_WRITE_STATUS_OK : FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+}
+
+/* collect frames in memory, dropping the stream header and metadata */
+static FLAC__StreamEncoderWriteStatus encoder_write_memory(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data) {
+	struct frame_list *l = (struct frame_list *) client_data;
+
+	if (samples > 0) {
+		PROBE3(frame_write, current_frame, bytes, samples);
+		frames_add_data(l, buffer, bytes, samples);
 	}
 
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static FLAC__StreamEncoderSeekStatus encoder_seek(const FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data) {
+	struct encoder_stream *s = (struct encoder_stream *) client_data;
+
+	/* libFLAC only seeks back to fill in STREAMINFO and the seek table once all frames are out */
+	s->verifier_fed = 0;
+
+	return output_seek(s->out, absolute_byte_offset) == 0 ? FLAC__STREAM_ENCODER_SEEK_STATUS_OK : FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+}
+
+static FLAC__StreamEncoderTellStatus encoder_tell(const FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_byte_offset, void *client_data) {
+	struct encoder_stream *s = (struct encoder_stream *) client_data;
+
+	*absolute_byte_offset = output_tell(s->out);
+
+	return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
+
+/* the audio and compression settings; libFLAC resets them every time an encoder is finished */
+static FLAC__bool encoder_configure(FLAC__StreamEncoder *encoder, size_t total_samples) {
+
+	FLAC__bool ok = true;
+
         ok &= FLAC__stream_encoder_set_verify(encoder, VERIFY ? true : false);
         ok &= FLAC__stream_encoder_set_compression_level(encoder, COMPRESSION_LEVEL);
         ok &= FLAC__stream_encoder_set_channels(encoder, CHANNELS);
@@ -70,44 +135,242 @@ int encoder_encode(char *filepath, int16_t *result, size_t result_len, size_t to
         ok &= FLAC__stream_encoder_set_sample_rate(encoder, SAMPLE_RATE);
         ok &= FLAC__stream_encoder_set_total_samples_estimate(encoder, total_samples);
 
+	return ok;
+}
+
+/* allocate an encoder with the audio and compression settings */
+static FLAC__StreamEncoder *encoder_new(size_t total_samples) {
+
+	FLAC__StreamEncoder *encoder = 0;
+
+	if ((encoder = FLAC__stream_encoder_new()) == NULL) {
+		fprintf(stderr, "ERROR: allocating encoder\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!encoder_configure(encoder, total_samples)) {
+		FLAC__stream_encoder_delete(encoder);
+		return NULL;
+	}
+
+	return encoder;
+}
+
+/* feed blocks of samples to the encoder, widened in `pcm` (READSIZE samples) */
+static FLAC__bool encoder_feed(FLAC__StreamEncoder *encoder, FLAC__int32 *pcm, const int16_t *samples, size_t nsamples) {
+
+	FLAC__bool ok = true;
+
+	while (ok && nsamples) {
+		size_t need = nsamples > READSIZE ? (size_t) READSIZE : nsamples;
+
+		/* widen the 16-bit samples to the FLAC__int32 libFLAC expects */
+		kernels_get()->widen((int32_t *) pcm, samples, need * CHANNELS);
+		PROBE1(block_submit, need);
+		ok = FLAC__stream_encoder_process_interleaved(encoder, pcm, need);
+		PROBE1(block_done, need);
+
+		samples += need * CHANNELS;
+		nsamples -= need;
+	}
+
+	return ok;
+}
+
+/*
+ * Encode `nsamples` samples into a list of frames held in memory. The
+ * frames can be written out (and renumbered) with flacstream_frame().
+ */
+int encoder_encode_frames(const int16_t *samples, size_t nsamples, struct frame_list *l) {
+
+	FLAC__int32 pcm[READSIZE * CHANNELS];
+	FLAC__bool ok = true;
+	FLAC__StreamEncoder *encoder;
+	FLAC__StreamEncoderInitStatus init_status;
+
+	encoder = encoder_new(nsamples);
+	if (encoder == NULL) {
+		return -1;
+	}
+
+	init_status = FLAC__stream_encoder_init_stream(encoder, encoder_write_memory, NULL, NULL, NULL, l);
+	if (init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+		fprintf(stderr, "ERROR: initializing encoder: %s\n", FLAC__StreamEncoderInitStatusString[init_status]);
+		ok = false;
+	}
+
+	if (ok) {
+		ok = encoder_feed(encoder, pcm, samples, nsamples);
+	}
+
+	ok &= FLAC__stream_encoder_finish(encoder);
+	FLAC__stream_encoder_delete(encoder);
+
+	return ok ? 0 : -1;
+}
+
+/*
+ * Start encoding to `filepath`. `total_samples` sizes the seek table; pass
+ * 0 when it isn't known yet and the file is written without one. The
+ * stream is also fed to `v` for verification unless it is NULL.
+ */
+struct encoder_stream *encoder_stream_open(char *filepath, size_t total_samples, struct verify *v) {
+	return encoder_stream_reopen(NULL, filepath, total_samples, v);
+}
+
+/*
+ * Same, reusing the libFLAC encoder of `s`, a stream that was finished
+ * with encoder_stream_finish(), instead of allocating a new one. A NULL
+ * `s` opens a new stream.
+ */
+struct encoder_stream *encoder_stream_reopen(struct encoder_stream *s, char *filepath, size_t total_samples, struct verify *v) {
+
+	FLAC__StreamMetadata *metadata[2];
+	unsigned num_metadata = 0;
+	FLAC__StreamEncoderInitStatus init_status;
+
+	if (s == NULL) {
+		s = (struct encoder_stream *) calloc(1, sizeof(struct encoder_stream));
+		if (s == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+		if ((s->encoder = encoder_new(total_samples)) == NULL) {
+			fprintf(stderr, "ERROR: configuring encoder\n");
+			exit(EXIT_FAILURE);
+		}
+	} else if (!encoder_configure(s->encoder, total_samples)) {
+		fprintf(stderr, "ERROR: configuring encoder\n");
+		exit(EXIT_FAILURE);
+	}
+	s->filepath = filepath;
+	s->ok = true;
+	s->verifier = v;
+	s->verifier_fed = v != NULL;
+	s->seektable = s->application = NULL;
+	memset(&s->frames, 0, sizeof(struct frame_list));
+
+	/* seek points are filled in by libFLAC as the frames are written */
+	if (s->ok && seek_interval > 0 && total_samples > 0) {
+		s->seektable = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE);
+		if (s->seektable == NULL || !FLAC__metadata_object_seektable_template_append_spaced_points_by_samples(s->seektable, seek_interval * SAMPLE_RATE, total_samples)) {
+			fprintf(stderr, "ERROR: allocating seek table\n");
+			s->ok = false;
+		} else {
+			metadata[num_metadata++] = s->seektable;
+		}
+	}
+
+	if (s->ok && application_data != NULL) {
+		s->application = FLAC__metadata_object_new(FLAC__METADATA_TYPE_APPLICATION);
+		if (s->application == NULL) {
+			fprintf(stderr, "ERROR: allocating application block\n");
+			s->ok = false;
+		} else {
+			memcpy(s->application->data.application.id, application_id, 4);
+			s->ok &= FLAC__metadata_object_application_set_data(s->application, application_data, application_len, true);
+			metadata[num_metadata++] = s->application;
+		}
+	}
+
+	if (s->ok && num_metadata > 0) {
+		s->ok &= FLAC__stream_encoder_set_metadata(s->encoder, metadata, num_metadata);
+	}
+
+	s->out = output_open(filepath);
+	if (s->out == NULL) {
+		fprintf(stderr, "ERROR: could not open output file '%s'\n", filepath);
+		exit(EXIT_FAILURE);
+	}
+
         /* initialize encoder */
-        if (ok) {
-                init_status = FLAC__stream_encoder_init_file(encoder, filepath, /*progress_callback*/NULL, /*client_data=*/NULL);
+        if (s->ok) {
+                init_status = FLAC__stream_encoder_init_stream(s->encoder, encoder_write, encoder_seek, encoder_tell, /*metadata_callback=*/NULL, /*client_data=*/s);
                 if (init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
                         fprintf(stderr, "ERROR: initializing encoder: %s\n", FLAC__StreamEncoderInitStatusString[init_status]);
-                        ok = false;
+                        s->ok = false;
                 }
         }
 
+	return s;
+}
 
-        /* read blocks of samples from WAVE file and feed to encoder */
-        if (ok) {
-                size_t left = (size_t)total_samples;
-                while(ok && left) {
-                        size_t need = (left>READSIZE? (size_t)READSIZE : (size_t)left);
-			size_t count;
-
-			count = fread(buffer, CHANNELS*(BPS/8), need, fin);
-                        if(count != need) {
-                                fprintf(stderr, "ERROR: reading from buffer result_len=%lu read=%lu need=%lu left=%lu size_per_elem=%d\n", result_len, count, need, left, CHANNELS*(BPS/8));
-                                ok = false;
-                        } else {
-                                /* convert the packed little-endian 16-bit PCM samples from WAVE into an interleaved FLAC__int32 buffer for libFLAC */
-                                size_t i;
-                                for (i = 0; i < need * CHANNELS; i++) {
-					pcm[i] = (FLAC__int32)(((FLAC__int16)(FLAC__int8)buffer[2*i+1] << 8) | (FLAC__int16)buffer[2*i]);
-                                }
-                                /* feed samples to encoder */
-                                ok = FLAC__stream_encoder_process_interleaved(encoder, pcm, need);
-                        }
-                        left -= need;
-                }
-        }
+/* feed the next `nsamples` samples to the encoder */
+int encoder_stream_write(struct encoder_stream *s, const int16_t *samples, size_t nsamples) {
 
-        ok &= FLAC__stream_encoder_finish(encoder);
+	if (s->ok) {
+		s->ok = encoder_feed(s->encoder, s->pcm, samples, nsamples);
+	}
+
+	return s->ok ? 0 : -1;
+}
+
+/*
+ * Flush the last frame, fill in STREAMINFO and the seek table, close the
+ * file. Where the frames were written goes to `frames` unless it is NULL.
+ * The libFLAC encoder is kept for encoder_stream_reopen(); release it with
+ * encoder_stream_free().
+ */
+int encoder_stream_finish(struct encoder_stream *s, struct frame_list *frames) {
+
+	FLAC__bool ok = s->ok;
+
+        ok &= FLAC__stream_encoder_finish(s->encoder);
+
+	if (s->seektable != NULL) {
+		FLAC__metadata_object_delete(s->seektable);
+	}
+	if (s->application != NULL) {
+		FLAC__metadata_object_delete(s->application);
+	}
+
+	if (output_close(s->out) == -1) {
+		fprintf(stderr, "ERROR: writing output file '%s'\n", s->filepath);
+		ok = false;
+	}
+
+	/* the decoder stopped at the rewrite of STREAMINFO and the seek table, check what was rewritten */
+	if (ok && s->verifier != NULL) {
+		verify_output(s->verifier, s->filepath, &s->frames);
+	}
 
-        FLAC__stream_encoder_delete(encoder);
-        fclose(fin);
+	if (frames != NULL) {
+		*frames = s->frames;
+	} else {
+		frames_free(&s->frames);
+	}
+	memset(&s->frames, 0, sizeof(struct frame_list));
+	s->seektable = s->application = NULL;
+	s->out = NULL;
 
 	return ok ? 0 : -1;
 }
+
+void encoder_stream_free(struct encoder_stream *s) {
+
+	if (s != NULL) {
+		FLAC__stream_encoder_delete(s->encoder);
+		free(s);
+	}
+}
+
+/* encoder_stream_finish() and encoder_stream_free() */
+int encoder_stream_close(struct encoder_stream *s, struct frame_list *frames) {
+
+	int rc;
+
+	rc = encoder_stream_finish(s, frames);
+	encoder_stream_free(s);
+
+	return rc;
+}
+
+int encoder_encode(char *filepath, const int16_t *result, size_t result_len, size_t total_samples, struct verify *v, struct frame_list *frames) {
+
+	struct encoder_stream *s;
+
+	s = encoder_stream_open(filepath, total_samples, v);
+	encoder_stream_write(s, result, total_samples);
+
+	return encoder_stream_close(s, frames);
+}
@@ -0,0 +1,328 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Key-down/key-up events for a text, for driving a transmitter or a
+ * light instead of a speaker. Computed from morse_alphabet and the
+ * nsamples_* timings alone; no audio is rendered. Timestamps are in
+ * samples, so they line up exactly with the audio render_text() makes.
+ */
+
+#include "encoder.h"
+#include "events.h"
+#include "morse.h"
+#include "normalize.h"
+#include "nsamples.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READSIZE (64 * 1024)
+#define WRITESIZE (64 * 1024)
+
+/* where the tones of a character are, relative to its start */
+struct events_character {
+	int ntones;
+	uint32_t start[EVENTS_MAX_ELEMENTS];
+	uint32_t len[EVENTS_MAX_ELEMENTS];
+	uint32_t total;
+};
+
+struct events_writer {
+	FILE *out;
+	char *filepath;
+	int format;
+	struct events_character chars[256];
+	uint32_t inter_character;
+	uint64_t t;		/* sample the next character starts at */
+	size_t first;		/* position of the next character in the input */
+	uint64_t last;		/* sample of the previous event */
+	int down;		/* the next event is a key-down */
+	size_t count;
+	size_t len;
+	char buf[WRITESIZE];
+};
+
+static const char *formats[] = { "bin", "csv", "json" };
+
+/* EVENTS_* for a format name, -1 if unknown */
+int events_format(const char *name) {
+	int i;
+
+	for (i = 0; i < (int) (sizeof(formats) / sizeof(formats[0])); i++) {
+		if (strcmp(name, formats[i]) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* lay out every character's tones; mirrors render_character() */
+static void events_init(struct events_character *chars, int wpm, int fwpm) {
+	uint32_t dit = nsamples_dit(wpm);
+	uint32_t dah = nsamples_dah(wpm);
+	uint32_t intra = nsamples_intra_character_space(wpm);
+	uint32_t word = nsamples_inter_word_space(fwpm);
+	int c;
+	int i;
+
+	for (c = 0; c < 256; c++) {
+		const char *s = morse_alphabet[c];
+		struct events_character *ec = &chars[c];
+		uint32_t t = 0;
+
+		ec->ntones = 0;
+		for (i = 0; s[i] != '\0'; i++) {
+			if (i != 0) {
+				t += intra;
+			}
+			switch (s[i]) {
+				case ' ':
+					t += word;
+					break;
+				case '.':
+				case '-':
+					ec->start[ec->ntones] = t;
+					ec->len[ec->ntones] = s[i] == '.' ? dit : dah;
+					t += ec->len[ec->ntones];
+					ec->ntones++;
+					break;
+			}
+		}
+		ec->total = t;
+	}
+}
+
+static int events_flush(struct events_writer *w) {
+	if (w->len > 0 && fwrite(w->buf, 1, w->len, w->out) != w->len) {
+		return -1;
+	}
+	w->len = 0;
+
+	return 0;
+}
+
+static void events_puts(struct events_writer *w, const char *s, size_t n) {
+	memcpy(w->buf + w->len, s, n);
+	w->len += n;
+}
+
+/* decimal digits of `v`, `width` digits zero padded when nonzero */
+static void events_putu(struct events_writer *w, uint64_t v, int width) {
+	char digits[24];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v > 0 || n < width);
+
+	while (n > 0) {
+		w->buf[w->len++] = digits[--n];
+	}
+}
+
+/* seconds with microsecond precision */
+static void events_puttime(struct events_writer *w, uint64_t sample) {
+	uint64_t us = sample * 1000000 / SAMPLE_RATE;
+
+	events_putu(w, us / 1000000, 0);
+	w->buf[w->len++] = '.';
+	events_putu(w, us % 1000000, 6);
+}
+
+static int events_emit(struct events_writer *w, uint64_t sample) {
+	uint64_t delta;
+
+	if (w->len + 128 > WRITESIZE && events_flush(w) == -1) {
+		return -1;
+	}
+
+	switch (w->format) {
+		case EVENTS_BINARY:
+			delta = sample - w->last;
+			do {
+				w->buf[w->len++] = (delta & 0x7f) | (delta > 0x7f ? 0x80 : 0x00);
+				delta >>= 7;
+			} while (delta > 0);
+			break;
+		case EVENTS_CSV:
+			events_putu(w, sample, 0);
+			w->buf[w->len++] = ',';
+			events_puttime(w, sample);
+			events_puts(w, w->down ? ",down\n" : ",up\n", w->down ? 6 : 4);
+			break;
+		case EVENTS_JSON:
+			events_puts(w, w->count == 0 ? "\n\t" : ",\n\t", w->count == 0 ? 2 : 3);
+			events_puts(w, "{\"sample\": ", 11);
+			events_putu(w, sample, 0);
+			events_puts(w, ", \"time\": ", 10);
+			events_puttime(w, sample);
+			events_puts(w, w->down ? ", \"key\": \"down\"}" : ", \"key\": \"up\"}", w->down ? 16 : 14);
+			break;
+	}
+
+	w->last = sample;
+	w->down = !w->down;
+	w->count++;
+
+	return 0;
+}
+
+/* open `output` ("-" for stdout) and write the format's header */
+static struct events_writer *events_open(char *output, int wpm, int fwpm, int format) {
+	struct events_writer *w;
+	int j;
+
+	w = (struct events_writer *) calloc(1, sizeof(struct events_writer));
+	if (w == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	events_init(w->chars, wpm, fwpm);
+	w->inter_character = nsamples_inter_character_space(fwpm);
+	w->filepath = output;
+	w->format = format;
+	w->down = 1;
+	w->out = strcmp(output, "-") == 0 ? stdout : fopen(output, format == EVENTS_BINARY ? "wb" : "w");
+	if (w->out == NULL) {
+		fprintf(stderr, "Could not open output file '%s'\n", output);
+		free(w);
+		return NULL;
+	}
+
+	switch (format) {
+		case EVENTS_BINARY:
+			events_puts(w, EVENTS_MAGIC, 4);
+			for (j = 0; j < 4; j++) {
+				w->buf[w->len++] = (SAMPLE_RATE >> (8 * j)) & 0xff;
+			}
+			break;
+		case EVENTS_CSV:
+			events_puts(w, "sample,seconds,key\n", 19);
+			break;
+		case EVENTS_JSON:
+			events_puts(w, "{\"sample_rate\": ", 16);
+			events_putu(w, SAMPLE_RATE, 0);
+			events_puts(w, ", \"events\": [", 13);
+			break;
+	}
+
+	return w;
+}
+
+/* the events for the next `n` bytes of text */
+static int events_text(struct events_writer *w, const unsigned char *text, size_t n) {
+	size_t i;
+	int j;
+	int ok = 1;
+
+	for (i = 0; ok && i < n; i++) {
+		const struct events_character *ec = &w->chars[text[i]];
+
+		if (w->first + i != 0) {
+			w->t += w->inter_character;
+		}
+		for (j = 0; j < ec->ntones; j++) {
+			ok &= events_emit(w, w->t + ec->start[j]) == 0;
+			ok &= events_emit(w, w->t + ec->start[j] + ec->len[j]) == 0;
+		}
+		w->t += ec->total;
+	}
+	w->first += n;
+
+	return ok ? 0 : -1;
+}
+
+/* finish the format, close the output and free `w` */
+static int events_close(struct events_writer *w, int ok) {
+
+	/* the audio may go on past the last key-up (trailing spaces) */
+	if (w->format == EVENTS_JSON) {
+		events_puts(w, w->count == 0 ? "], \"samples\": " : "\n], \"samples\": ", w->count == 0 ? 14 : 15);
+		events_putu(w, w->t, 0);
+		events_puts(w, "}\n", 2);
+	}
+	ok &= events_flush(w) == 0;
+
+	if (w->out != stdout) {
+		ok &= fclose(w->out) == 0;
+	} else {
+		ok &= fflush(w->out) == 0;
+	}
+	if (!ok) {
+		fprintf(stderr, "Could not write output file '%s'\n", w->filepath);
+	}
+	free(w);
+
+	return ok ? 0 : -1;
+}
+
+/*
+ * Write the key-down/key-up events for all of `input` to `output` ("-"
+ * for stdout) in the given EVENTS_* format.
+ */
+int events_file(FILE *input, char *output, int wpm, int fwpm, int format) {
+	static unsigned char text[READSIZE];
+	struct events_writer *w;
+	struct normalize st;
+	size_t n;
+	int ok = 1;
+	int rc = 0;
+
+	w = events_open(output, wpm, fwpm, format);
+	if (w == NULL) {
+		return -1;
+	}
+
+	normalize_init(&st);
+	while (ok && (n = normalize_fread(&st, text, sizeof(text), input)) > 0) {
+		ok = events_text(w, text, n) == 0;
+	}
+
+	if (ferror(input)) {
+		fprintf(stderr, "Could not read the input\n");
+		rc = -1;
+	}
+
+	if (events_close(w, ok) == -1) {
+		rc = -1;
+	}
+
+	return rc;
+}
+
+/* same for text already in memory; safe to run on several threads at once */
+int events_buffer(const unsigned char *text, size_t len, char *output, int wpm, int fwpm, int format) {
+	struct events_writer *w;
+	int ok;
+
+	w = events_open(output, wpm, fwpm, format);
+	if (w == NULL) {
+		return -1;
+	}
+	ok = events_text(w, text, len) == 0;
+
+	return events_close(w, ok);
+}
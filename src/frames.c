@@ -0,0 +1,494 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Frame level FLAC handling. Encoded frames can be moved to a different
+ * position in a stream by rewriting the sample number in their header and
+ * the two CRCs; the subframes are copied untouched. Streams put together
+ * this way use the variable block size strategy, which lets every frame
+ * (not just the last one) be shorter than the block size.
+ *
+ * Frame header layout: https://xiph.org/flac/format.html#frame_header
+ */
+
+#include "bytes.h"
+#include "encoder.h"
+#include "frames.h"
+#include "output.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *frames_grow(void *p, size_t *cap, size_t need, size_t size) {
+	void *new_p;
+	size_t new_cap = *cap == 0 ? 64 : *cap;
+
+	if (need <= *cap) {
+		return p;
+	}
+	while (new_cap < need) {
+		new_cap *= 2;
+	}
+	new_p = realloc(p, new_cap * size);
+	if (new_p == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	*cap = new_cap;
+
+	return new_p;
+}
+
+void frames_add(struct frame_list *l, uint64_t offset, uint32_t bytes, uint64_t sample, uint32_t samples) {
+	l->frames = (struct frame *) frames_grow(l->frames, &l->cap, l->len + 1, sizeof(struct frame));
+	l->frames[l->len].offset = offset;
+	l->frames[l->len].bytes = bytes;
+	l->frames[l->len].sample = sample;
+	l->frames[l->len].samples = samples;
+	l->len++;
+}
+
+/* append a copy of an encoded frame, numbered after the frames before it */
+void frames_add_data(struct frame_list *l, const unsigned char *data, size_t bytes, uint32_t samples) {
+	uint64_t sample = l->len == 0 ? 0 : l->frames[l->len - 1].sample + l->frames[l->len - 1].samples;
+
+	l->data = (unsigned char *) frames_grow(l->data, &l->data_cap, l->data_len + bytes, 1);
+	memcpy(l->data + l->data_len, data, bytes);
+	frames_add(l, l->data_len, bytes, sample, samples);
+	l->data_len += bytes;
+}
+
+void frames_free(struct frame_list *l) {
+	free(l->frames);
+	free(l->data);
+	memset(l, 0, sizeof(struct frame_list));
+}
+
+/* CRC-8, polynomial x^8 + x^2 + x^1 + x^0 */
+static uint8_t frames_crc8(const unsigned char *data, size_t len) {
+	uint8_t crc = 0;
+	size_t i;
+	int j;
+
+	for (i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (j = 0; j < 8; j++) {
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+		}
+	}
+
+	return crc;
+}
+
+/* CRC-16, polynomial x^16 + x^15 + x^2 + x^0 */
+static uint16_t crc16_table[256];
+
+static uint16_t frames_crc16(const unsigned char *data, size_t len) {
+	static int table_ready = 0;
+	uint16_t crc = 0;
+	size_t i;
+	int j;
+
+	if (!table_ready) {
+		for (i = 0; i < 256; i++) {
+			crc = i << 8;
+			for (j = 0; j < 8; j++) {
+				crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1;
+			}
+			crc16_table[i] = crc;
+		}
+		table_ready = 1;
+		crc = 0;
+	}
+
+	for (i = 0; i < len; i++) {
+		crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ data[i]) & 0xff];
+	}
+
+	return crc;
+}
+
+/* length of the UTF-8 style coded frame/sample number starting with `b` */
+static size_t frames_number_len(unsigned char b) {
+	size_t n = 0;
+
+	if ((b & 0x80) == 0) {
+		return 1;
+	}
+	while (n < 8 && (b & (0x80 >> n))) {
+		n++;
+	}
+
+	return n;
+}
+
+/* write `v` (up to 36 bits) as a UTF-8 style coded number */
+static size_t frames_number_put(unsigned char *p, uint64_t v) {
+	size_t n;
+	size_t i;
+
+	if (v < 0x80) {
+		p[0] = v;
+		return 1;
+	}
+
+	if (v < 0x800) n = 2;
+	else if (v < 0x10000) n = 3;
+	else if (v < 0x200000) n = 4;
+	else if (v < 0x4000000) n = 5;
+	else if (v < 0x80000000) n = 6;
+	else n = 7;
+
+	for (i = n - 1; i > 0; i--) {
+		p[i] = 0x80 | (v & 0x3f);
+		v >>= 6;
+	}
+	p[0] = (0xff00 >> n) | v;
+
+	return n;
+}
+
+/*
+ * Copy the frame `src` of `len` bytes to `dst` as a variable block size
+ * frame starting at `sample`. `dst` needs room for len + FRAMES_MAX_GROWTH
+ * bytes. Returns the length of the new frame, or 0 if `src` isn't a frame.
+ */
+size_t frames_renumber(unsigned char *dst, const unsigned char *src, size_t len, uint64_t sample) {
+	size_t num_len;
+	size_t extra;
+	size_t crc8_pos;
+	size_t n;
+	uint16_t crc16;
+
+	if (len < 8 || src[0] != 0xff || (src[1] & 0xfe) != 0xf8) {
+		return 0;
+	}
+
+	num_len = frames_number_len(src[4]);
+	extra = 0;
+	switch (src[2] >> 4) {		/* block size stored at the end of the header */
+		case 6: extra += 1; break;
+		case 7: extra += 2; break;
+	}
+	switch (src[2] & 0x0f) {	/* sample rate stored at the end of the header */
+		case 12: extra += 1; break;
+		case 13: case 14: extra += 2; break;
+	}
+	crc8_pos = 4 + num_len + extra;
+	if (crc8_pos + 3 > len) {
+		return 0;
+	}
+
+	dst[0] = 0xff;
+	dst[1] = 0xf9;
+	dst[2] = src[2];
+	dst[3] = src[3];
+	n = 4 + frames_number_put(dst + 4, sample);
+	memcpy(dst + n, src + 4 + num_len, extra);
+	n += extra;
+
+	if (n == crc8_pos && memcmp(dst, src, n) == 0) {
+		/* header unchanged, so is the rest of the frame */
+		memcpy(dst, src, len);
+		return len;
+	}
+
+	dst[n] = frames_crc8(dst, n);
+	n++;
+
+	memcpy(dst + n, src + crc8_pos + 1, len - crc8_pos - 3);
+	n += len - crc8_pos - 3;
+
+	crc16 = frames_crc16(dst, n);
+	dst[n++] = crc16 >> 8;
+	dst[n++] = crc16 & 0xff;
+
+	return n;
+}
+
+/*
+ * Check the frame header at `src` (sync code and CRC-8). Returns its
+ * length including the CRC-8 and sets `samples` to the block size, or
+ * returns 0 if there's no valid header there.
+ */
+static size_t frames_header(const unsigned char *src, size_t len, uint32_t *samples) {
+	size_t num_len;
+	size_t n;
+	int code;
+
+	if (len < 6 || src[0] != 0xff || (src[1] & 0xfe) != 0xf8 || (src[4] & 0xc0) == 0x80) {
+		return 0;
+	}
+
+	num_len = frames_number_len(src[4]);
+	n = 4 + num_len;
+	code = src[2] >> 4;
+	if (num_len > 7 || code == 0 || (src[2] & 0x0f) == 0x0f) {
+		return 0;
+	}
+
+	switch (src[2] & 0x0f) {	/* sample rate stored at the end of the header */
+		case 12: n += 1; break;
+		case 13: case 14: n += 2; break;
+	}
+	if (code == 6 || code == 7) {
+		n += code - 5;
+	}
+	if (n + 1 > len || frames_crc8(src, n) != src[n]) {
+		return 0;
+	}
+
+	if (code == 1) {
+		*samples = 192;
+	} else if (code <= 5) {
+		*samples = 576 << (code - 2);
+	} else if (code == 6) {
+		*samples = src[4 + num_len] + 1;
+	} else if (code == 7) {
+		*samples = ((src[4 + num_len] << 8) | src[4 + num_len + 1]) + 1;
+	} else {
+		*samples = 256 << (code - 8);
+	}
+
+	return n + 1;
+}
+
+/*
+ * Find the frames in `len` bytes of encoded audio (everything after the
+ * metadata) without decoding them: a frame ends where the bytes so far
+ * pass the frame's CRC-16 and another valid header, or the end, follows.
+ * Offsets are relative to `data`. Returns -1 if the bytes aren't a
+ * sequence of whole frames.
+ */
+int frames_scan(const unsigned char *data, size_t len, struct frame_list *l) {
+	size_t start = 0;
+	size_t q;
+	size_t hdr;
+	uint64_t sample = 0;
+	uint32_t samples;
+	uint32_t next;
+	uint16_t crc;
+
+	frames_crc16(data, 0);	/* sets up the table used below */
+
+	while (start < len) {
+		hdr = frames_header(data + start, len - start, &samples);
+		if (hdr == 0) {
+			return -1;
+		}
+
+		crc = frames_crc16(data + start, hdr);
+		for (q = start + hdr; q < len; q++) {
+			crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ data[q]) & 0xff];
+			if (crc == 0 && (q + 1 == len || frames_header(data + q + 1, len - q - 1, &next) != 0)) {
+				break;
+			}
+		}
+		if (q == len) {
+			return -1;
+		}
+
+		frames_add(l, start, q + 1 - start, sample, samples);
+		sample += samples;
+		start = q + 1;
+	}
+
+	return 0;
+}
+
+struct flacstream {
+	struct output *out;
+	uint64_t total_samples;
+	uint64_t seek_samples;		/* distance between seek points */
+	uint32_t seek_points;
+	uint64_t seektable_offset;
+	uint64_t first_frame;		/* byte offset of the first frame */
+	uint64_t sample;
+	struct frame_list frames;
+	unsigned char *buf;
+	size_t buf_cap;
+};
+
+/* metadata block header: last flag, type, 24-bit length */
+static int flacstream_block(struct output *out, int last, int type, size_t len) {
+	unsigned char hdr[4];
+
+	hdr[0] = (last ? 0x80 : 0x00) | type;
+	bytes_put_be(hdr + 1, len, 3);
+
+	return output_write(out, hdr, 4);
+}
+
+/*
+ * Start a stream of `total_samples` samples. STREAMINFO and the seek table
+ * are written as placeholders and filled in by flacstream_close().
+ */
+struct flacstream *flacstream_open(char *filepath, uint64_t total_samples, int seek_interval, char *app_id, unsigned char *app_data, size_t app_len) {
+	static unsigned char placeholder[18] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+	unsigned char streaminfo[34];
+	struct flacstream *fs;
+	uint32_t i;
+	int ok = 1;
+
+	fs = (struct flacstream *) calloc(1, sizeof(struct flacstream));
+	if (fs == NULL) {
+		return NULL;
+	}
+
+	fs->out = output_open(filepath);
+	if (fs->out == NULL) {
+		free(fs);
+		return NULL;
+	}
+
+	fs->total_samples = total_samples;
+	if (seek_interval > 0 && total_samples > 0) {
+		fs->seek_samples = (uint64_t) seek_interval * SAMPLE_RATE;
+		fs->seek_points = (total_samples - 1) / fs->seek_samples + 1;
+	}
+
+	memset(streaminfo, 0, sizeof(streaminfo));
+	ok &= output_write(fs->out, "fLaC", 4) == 0;
+	ok &= flacstream_block(fs->out, fs->seek_points == 0 && app_data == NULL, 0, sizeof(streaminfo)) == 0;
+	ok &= output_write(fs->out, streaminfo, sizeof(streaminfo)) == 0;
+
+	if (fs->seek_points > 0) {
+		ok &= flacstream_block(fs->out, app_data == NULL, 3, 18 * fs->seek_points) == 0;
+		fs->seektable_offset = output_tell(fs->out);
+		for (i = 0; i < fs->seek_points; i++) {
+			ok &= output_write(fs->out, placeholder, sizeof(placeholder)) == 0;
+		}
+	}
+
+	if (app_data != NULL) {
+		ok &= flacstream_block(fs->out, 1, 2, 4 + app_len) == 0;
+		ok &= output_write(fs->out, app_id, 4) == 0;
+		ok &= output_write(fs->out, app_data, app_len) == 0;
+	}
+
+	fs->first_frame = output_tell(fs->out);
+
+	if (!ok) {
+		output_close(fs->out);
+		free(fs);
+		return NULL;
+	}
+
+	return fs;
+}
+
+/* append an encoded frame of `samples` samples, renumbering it */
+int flacstream_frame(struct flacstream *fs, const unsigned char *frame, size_t len, uint32_t samples) {
+	size_t n;
+
+	fs->buf = (unsigned char *) frames_grow(fs->buf, &fs->buf_cap, len + FRAMES_MAX_GROWTH, 1);
+
+	n = frames_renumber(fs->buf, frame, len, fs->sample);
+	if (n == 0) {
+		return -1;
+	}
+
+	frames_add(&fs->frames, output_tell(fs->out), n, fs->sample, samples);
+	fs->sample += samples;
+
+	return output_write(fs->out, fs->buf, n);
+}
+
+/* fill in STREAMINFO and the seek table, then close the file */
+int flacstream_close(struct flacstream *fs, const unsigned char md5[16], struct frame_list *frames) {
+	unsigned char streaminfo[34];
+	unsigned char point[18];
+	uint32_t min_block = 0, max_block = 0, min_frame = 0, max_frame = 0;
+	uint64_t v;
+	size_t i;
+	size_t f;
+	size_t prev;
+	uint32_t npoints;
+	int ok = 1;
+
+	for (i = 0; i < fs->frames.len; i++) {
+		struct frame *fr = &fs->frames.frames[i];
+
+		/* the minimum block size doesn't count the last block */
+		if (i + 1 < fs->frames.len || fs->frames.len == 1) {
+			min_block = (min_block == 0 || fr->samples < min_block) ? fr->samples : min_block;
+		}
+		max_block = fr->samples > max_block ? fr->samples : max_block;
+		min_frame = (min_frame == 0 || fr->bytes < min_frame) ? fr->bytes : min_frame;
+		max_frame = fr->bytes > max_frame ? fr->bytes : max_frame;
+	}
+
+	ok &= fs->sample == fs->total_samples;
+
+	bytes_put_be(streaminfo + 0, min_block, 2);
+	bytes_put_be(streaminfo + 2, max_block, 2);
+	bytes_put_be(streaminfo + 4, min_frame, 3);
+	bytes_put_be(streaminfo + 7, max_frame, 3);
+	v = ((uint64_t) SAMPLE_RATE << 44) | ((uint64_t) (CHANNELS - 1) << 41) | ((uint64_t) (BPS - 1) << 36) | (fs->sample & 0xfffffffffULL);
+	bytes_put_be(streaminfo + 10, v, 8);
+	if (md5 != NULL) {
+		memcpy(streaminfo + 18, md5, 16);
+	} else {
+		memset(streaminfo + 18, 0, 16);
+	}
+
+	ok &= output_seek(fs->out, 8) == 0;
+	ok &= output_write(fs->out, streaminfo, sizeof(streaminfo)) == 0;
+
+	/* one point per interval on the frame holding that sample, no duplicates; the rest stay placeholders */
+	if (fs->seek_points > 0) {
+		ok &= output_seek(fs->out, fs->seektable_offset) == 0;
+		npoints = 0;
+		f = 0;
+		prev = 0;
+		for (i = 0; i < fs->seek_points && fs->frames.len > 0; i++) {
+			uint64_t target = i * fs->seek_samples;
+			struct frame *fr;
+
+			while (f + 1 < fs->frames.len && fs->frames.frames[f].sample + fs->frames.frames[f].samples <= target) {
+				f++;
+			}
+			if (npoints > 0 && f == prev) {
+				continue;
+			}
+			fr = &fs->frames.frames[f];
+			bytes_put_be(point, fr->sample, 8);
+			bytes_put_be(point + 8, fr->offset - fs->first_frame, 8);
+			bytes_put_be(point + 16, fr->samples, 2);
+			ok &= output_write(fs->out, point, sizeof(point)) == 0;
+			prev = f;
+			npoints++;
+		}
+	}
+
+	ok &= output_close(fs->out) == 0;
+
+	if (frames != NULL) {
+		*frames = fs->frames;
+	} else {
+		frames_free(&fs->frames);
+	}
+	free(fs->buf);
+	free(fs);
+
+	return ok ? 0 : -1;
+}
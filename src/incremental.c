@@ -0,0 +1,208 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "encoder.h"
+#include "frames.h"
+#include "incremental.h"
+#include "manifest.h"
+#include "md5.h"
+#include "measure.h"
+#include "render.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* out/msg.flac -> out/.msg.flac.PID.tmp, next to it so it can be renamed over it */
+static char *incremental_temp_name(const char *filepath) {
+	const char *slash = strrchr(filepath, '/');
+	size_t dir = slash == NULL ? 0 : slash - filepath + 1;
+	char *tmp;
+
+	tmp = (char *) malloc(strlen(filepath) + 32);
+	if (tmp == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(tmp, "%.*s.%s.%d.tmp", (int) dir, filepath, filepath + dir, (int) getpid());
+
+	return tmp;
+}
+
+/*
+ * Copy frames [first, last) of the old output into the new stream, shifted
+ * to follow what's there. `buf` holds `buf_len` bytes and grows as needed.
+ */
+static int incremental_copy(struct flacstream *fs, int fd, struct frame_list *old, size_t first, size_t last, unsigned char **buf, size_t *buf_len) {
+	size_t i;
+
+	for (i = first; i < last; i++) {
+		struct frame *f = &old->frames[i];
+
+		if (f->bytes > *buf_len) {
+			unsigned char *new_buf = (unsigned char *) realloc(*buf, f->bytes);
+			if (new_buf == NULL) {
+				return -1;
+			}
+			*buf = new_buf;
+			*buf_len = f->bytes;
+		}
+		if (pread(fd, *buf, f->bytes, f->offset) != (ssize_t) f->bytes) {
+			return -1;
+		}
+		if (flacstream_frame(fs, *buf, f->bytes, f->samples) == -1) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Re-encode only what changed since the output described by `old`. The
+ * new text in `cur` has already been rendered to `samples` (rendering is
+ * cheap; encoding is what takes the time). Frames covering an unchanged
+ * prefix or suffix of the text are copied from the old output with new
+ * sample numbers; only the samples between them go through libFLAC.
+ *
+ * The new output is written to a temporary file next to `filepath` and
+ * renamed over it once complete, so a failure leaves the old output (and
+ * the manifest describing it) as they were.
+ *
+ * Returns 0 on success with cur->frames filled in, 1 if the old output
+ * can't be reused (different settings, missing file), -1 on error.
+ */
+int incremental_encode(char *filepath, char *old_filepath, struct manifest *old, struct manifest *cur, int16_t *samples,
+	int seek_interval, char *app_id, unsigned char *app_data, size_t app_len, size_t *reused) {
+
+	struct measure m;
+	struct frame_list mid;
+	struct flacstream *fs;
+	struct stat old_st;
+	struct md5 md5;
+	unsigned char digest[16];
+	size_t min_len, p, q;
+	size_t pre, suf, i;
+	uint64_t prefix_end, old_suffix, new_suffix, a, b;
+	unsigned char *buf = NULL;	/* one frame of the old output */
+	size_t buf_len = 0;
+	char *tmp;
+	int fd;
+	int rc = 0;
+
+	if (old->wpm != cur->wpm || old->fwpm != cur->fwpm || old->frequency != cur->frequency || old->envelope != cur->envelope) {
+		return 1;
+	}
+
+	fd = open(old_filepath, O_RDONLY);
+	if (fd == -1) {
+		return 1;
+	}
+	if (fstat(fd, &old_st) == -1 || (old->frames.len > 0 &&
+			old->frames.frames[old->frames.len - 1].offset + old->frames.frames[old->frames.len - 1].bytes > (uint64_t) old_st.st_size)) {
+		close(fd);
+		return 1;
+	}
+
+	render_measure(&m);
+
+	/* common prefix and suffix of the two texts; the suffix never starts at byte 0 of either */
+	min_len = old->text_len < cur->text_len ? old->text_len : cur->text_len;
+	for (p = 0; p < min_len && old->text[p] == cur->text[p]; p++);
+	for (q = 0; q + p < min_len && q + 1 < min_len && old->text[old->text_len - 1 - q] == cur->text[cur->text_len - 1 - q]; q++);
+
+	/* frames entirely inside the unchanged prefix */
+	prefix_end = measure_text(&m, cur->text, p, 0);
+	for (pre = 0; pre < old->frames.len && old->frames.frames[pre].sample + old->frames.frames[pre].samples <= prefix_end; pre++);
+	a = pre == 0 ? 0 : old->frames.frames[pre - 1].sample + old->frames.frames[pre - 1].samples;
+
+	/* frames entirely inside the unchanged suffix, as long as they start after the prefix frames */
+	old_suffix = measure_text(&m, old->text, old->text_len - q, 0);
+	new_suffix = measure_text(&m, cur->text, cur->text_len - q, 0);
+	b = cur->total_samples;
+	suf = old->frames.len;
+	if (q > 0 && new_suffix + (old->total_samples - old_suffix) == cur->total_samples) {
+		for (i = pre; i < old->frames.len; i++) {
+			struct frame *f = &old->frames.frames[i];
+
+			if (f->sample >= old_suffix && f->sample - old_suffix + new_suffix >= a) {
+				suf = i;
+				b = f->sample - old_suffix + new_suffix;
+				break;
+			}
+		}
+	}
+
+	memset(&mid, 0, sizeof(struct frame_list));
+	if (b > a && encoder_encode_frames(samples + a, b - a, &mid) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	tmp = incremental_temp_name(filepath);
+	fs = flacstream_open(tmp, cur->total_samples, seek_interval, app_id, app_data, app_len);
+	if (fs == NULL) {
+		free(tmp);
+		frames_free(&mid);
+		close(fd);
+		return -1;
+	}
+
+	if (incremental_copy(fs, fd, &old->frames, 0, pre, &buf, &buf_len) == -1) {
+		rc = -1;
+	}
+	for (i = 0; rc == 0 && i < mid.len; i++) {
+		if (flacstream_frame(fs, mid.data + mid.frames[i].offset, mid.frames[i].bytes, mid.frames[i].samples) == -1) {
+			rc = -1;
+		}
+	}
+	if (rc == 0 && incremental_copy(fs, fd, &old->frames, suf, old->frames.len, &buf, &buf_len) == -1) {
+		rc = -1;
+	}
+
+	md5_init(&md5);
+	md5_update_samples(&md5, samples, cur->total_samples);
+	md5_final(&md5, digest);
+
+	if (flacstream_close(fs, digest, &cur->frames) == -1) {
+		rc = -1;
+	}
+	if (rc == 0 && rename(tmp, filepath) == -1) {
+		fprintf(stderr, "Could not write output file '%s'\n", filepath);
+		rc = -1;
+	}
+	if (rc != 0) {
+		unlink(tmp);
+	}
+	free(tmp);
+
+	*reused = pre + (old->frames.len - suf);
+
+	free(buf);
+	frames_free(&mid);
+	close(fd);
+
+	return rc;
+}
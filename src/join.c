@@ -0,0 +1,219 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Join FLAC files made by text-to-morse (a preamble, a message, a
+ * sign-off) into one without decoding them. Every output has the same
+ * sample rate, sample size and channel count, so the frames of each file
+ * are found by their headers and CRCs and copied over with new numbers,
+ * the same way incremental re-export copies unchanged frames. A gap of
+ * silence between files is encoded once and copied in between.
+ *
+ * STREAMINFO gets the new totals and frame sizes. The MD5 of the joined
+ * audio can't be worked out from the MD5s of the parts without decoding
+ * them, so it is left zero ("not computed").
+ */
+
+#include "bytes.h"
+#include "encoder.h"
+#include "frames.h"
+#include "join.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * Read the metadata of `filepath`: the number of samples from STREAMINFO
+ * and where the first frame starts. Returns -1 if it isn't a FLAC file in
+ * our format.
+ */
+static int join_info(char *filepath, uint64_t *total, long *first_frame) {
+	FILE *in;
+	unsigned char hdr[4];
+	unsigned char info[34];
+	uint64_t v;
+	size_t len;
+	int last = 0;
+	int have_info = 0;
+	int ok;
+
+	in = fopen(filepath, "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Could not open input file '%s'\n", filepath);
+		return -1;
+	}
+
+	ok = fread(hdr, 1, 4, in) == 4 && memcmp(hdr, "fLaC", 4) == 0;
+	while (ok && !last) {
+		ok = fread(hdr, 1, 4, in) == 4;
+		last = hdr[0] & 0x80;
+		len = bytes_get_be(hdr + 1, 3);
+		if (ok && (hdr[0] & 0x7f) == 0 && len == sizeof(info)) {
+			ok = fread(info, 1, sizeof(info), in) == sizeof(info);
+			v = bytes_get_be(info + 10, 8);
+			ok &= (v >> 44) == SAMPLE_RATE && ((v >> 41) & 0x7) == CHANNELS - 1 && ((v >> 36) & 0x1f) == BPS - 1;
+			*total = v & 0xfffffffffULL;
+			have_info = 1;
+		} else if (ok) {
+			ok = fseek(in, len, SEEK_CUR) == 0;
+		}
+	}
+	*first_frame = ftell(in);
+	fclose(in);
+
+	if (!ok || !have_info) {
+		fprintf(stderr, "'%s' isn't a %d Hz, %d-bit, %d channel FLAC file\n", filepath, SAMPLE_RATE, BPS, CHANNELS);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* copy the frames of `filepath`, which hold `total` samples from `first_frame` on */
+static int join_copy(struct flacstream *fs, char *filepath, uint64_t total, long first_frame) {
+	FILE *in;
+	unsigned char *data;
+	long end;
+	size_t len;
+	struct frame_list l;
+	size_t i;
+	int rc = 0;
+
+	in = fopen(filepath, "rb");
+	if (in == NULL || fseek(in, 0, SEEK_END) == -1 || (end = ftell(in)) < first_frame || fseek(in, first_frame, SEEK_SET) == -1) {
+		fprintf(stderr, "Could not read input file '%s'\n", filepath);
+		if (in != NULL) {
+			fclose(in);
+		}
+		return -1;
+	}
+
+	len = end - first_frame;
+	data = (unsigned char *) malloc(len > 0 ? len : 1);
+	if (data == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	if (fread(data, 1, len, in) != len) {
+		fprintf(stderr, "Could not read input file '%s'\n", filepath);
+		rc = -1;
+	}
+	fclose(in);
+
+	memset(&l, 0, sizeof(struct frame_list));
+	if (rc == 0 && (frames_scan(data, len, &l) == -1 || (l.len > 0 ? l.frames[l.len - 1].sample + l.frames[l.len - 1].samples : 0) != total)) {
+		fprintf(stderr, "'%s' is damaged or incomplete\n", filepath);
+		rc = -1;
+	}
+
+	for (i = 0; rc == 0 && i < l.len; i++) {
+		rc = flacstream_frame(fs, data + l.frames[i].offset, l.frames[i].bytes, l.frames[i].samples);
+	}
+
+	frames_free(&l);
+	free(data);
+
+	return rc;
+}
+
+/*
+ * Join `ninputs` FLAC files into `filepath`, with `gap` samples of
+ * silence between each two. Returns 0 on success, -1 on error.
+ */
+int join_files(char **inputs, int ninputs, char *filepath, size_t gap, int seek_interval) {
+	struct flacstream *fs;
+	struct frame_list silence;
+	struct stat out;
+	struct stat st;
+	uint64_t *totals;
+	long *first_frames;
+	uint64_t total = 0;
+	int16_t *zeros;
+	size_t j;
+	int i;
+	int rc = 0;
+
+	totals = (uint64_t *) malloc(ninputs * sizeof(uint64_t));
+	first_frames = (long *) malloc(ninputs * sizeof(long));
+	if (totals == NULL || first_frames == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* the totals go into STREAMINFO and size the seek table, so they're needed up front */
+	for (i = 0; i < ninputs; i++) {
+		if (stat(filepath, &out) == 0 && stat(inputs[i], &st) == 0 && out.st_dev == st.st_dev && out.st_ino == st.st_ino) {
+			fprintf(stderr, "The output can't also be an input: '%s'\n", inputs[i]);
+			rc = -1;
+		}
+		if (rc == -1 || join_info(inputs[i], &totals[i], &first_frames[i]) == -1) {
+			free(totals);
+			free(first_frames);
+			return -1;
+		}
+		total += totals[i] + (i > 0 ? gap : 0);
+	}
+
+	memset(&silence, 0, sizeof(struct frame_list));
+	if (gap > 0 && ninputs > 1) {
+		zeros = (int16_t *) calloc(gap, sizeof(int16_t));
+		if (zeros == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+		rc = encoder_encode_frames(zeros, gap, &silence);
+		free(zeros);
+	}
+
+	fs = rc == 0 ? flacstream_open(filepath, total, seek_interval, NULL, NULL, 0) : NULL;
+	if (fs == NULL) {
+		fprintf(stderr, "Could not write output file '%s'\n", filepath);
+		frames_free(&silence);
+		free(totals);
+		free(first_frames);
+		return -1;
+	}
+
+	for (i = 0; rc == 0 && i < ninputs; i++) {
+		for (j = 0; i > 0 && rc == 0 && j < silence.len; j++) {
+			rc = flacstream_frame(fs, silence.data + silence.frames[j].offset, silence.frames[j].bytes, silence.frames[j].samples);
+		}
+		if (rc == 0) {
+			rc = join_copy(fs, inputs[i], totals[i], first_frames[i]);
+		}
+	}
+
+	if (flacstream_close(fs, NULL, NULL) == -1) {
+		if (rc == 0) {
+			fprintf(stderr, "Could not write output file '%s'\n", filepath);
+		}
+		rc = -1;
+	}
+
+	frames_free(&silence);
+	free(totals);
+	free(first_frames);
+
+	return rc;
+}
@@ -0,0 +1,288 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * The loops that touch every sample, in one version per instruction set,
+ * picked once at runtime from what the CPU supports. A single build then
+ * runs with AVX-512 where it is available and still runs on machines
+ * with only SSE2, without SIGILL.
+ *
+ *   widen	int16 samples to the int32 libFLAC takes (encoder.c)
+ *   copy	an element into the render buffer (render.c)
+ *   zero	silence into the render buffer (render.c)
+ *   phasor	the tone oscillator's rotating phasors (tone.c)
+ *
+ * The scalar versions are the reference. The others must produce exactly
+ * the same samples. For the phasor that means the same double operations
+ * in the same order, with no FMA, and the same KERNELS_TONE_LANES lanes.
+ * GCC fuses a*b+c into an FMA by default when the target has one, so this
+ * file, tone.c, tools/presets.c and tests/kernels.c are built with
+ * -ffp-contract=off (CMakeLists.txt).
+ * AVX-512 therefore keeps the AVX2 phasor rather than taking eight lanes
+ * at a time.
+ */
+
+#include "kernels.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+static void kernels_widen_scalar(int32_t *dst, const int16_t *src, size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = src[i];
+	}
+}
+
+static void kernels_copy_scalar(int16_t *dst, const int16_t *src, size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = src[i];
+	}
+}
+
+static void kernels_zero_scalar(int16_t *dst, size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = 0;
+	}
+}
+
+/* write `n` samples of `volume` * the phasors' sines, rotating the phasors by `step` every KERNELS_TONE_LANES samples */
+static void kernels_phasor_scalar(int16_t *dst, size_t n, double re[KERNELS_TONE_LANES], double im[KERNELS_TONE_LANES], double step_re, double step_im, double volume) {
+	double t;
+	size_t j;
+	size_t k;
+
+	for (j = 0; j + KERNELS_TONE_LANES <= n; j += KERNELS_TONE_LANES) {
+		for (k = 0; k < KERNELS_TONE_LANES; k++) {
+			dst[j + k] = volume * im[k];
+			t = re[k] * step_re - im[k] * step_im;
+			im[k] = re[k] * step_im + im[k] * step_re;
+			re[k] = t;
+		}
+	}
+	for (k = 0; j < n; j++, k++) {
+		dst[j] = volume * im[k];
+	}
+}
+
+#ifdef KERNELS_X86
+
+__attribute__((target("sse2")))
+static void kernels_widen_sse2(int32_t *dst, const int16_t *src, size_t n) {
+	__m128i x;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		x = _mm_loadu_si128((const __m128i *) (src + i));
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+		_mm_storeu_si128((__m128i *) (dst + i + 4), _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+	}
+	kernels_widen_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void kernels_copy_sse2(int16_t *dst, const int16_t *src, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_loadu_si128((const __m128i *) (src + i)));
+	}
+	kernels_copy_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void kernels_zero_sse2(int16_t *dst, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_setzero_si128());
+	}
+	kernels_zero_scalar(dst + i, n - i);
+}
+
+/* lanes 0-1 and 2-3 in two registers */
+__attribute__((target("sse2")))
+static void kernels_phasor_sse2(int16_t *dst, size_t n, double re[KERNELS_TONE_LANES], double im[KERNELS_TONE_LANES], double step_re, double step_im, double volume) {
+	const __m128d sr = _mm_set1_pd(step_re);
+	const __m128d si = _mm_set1_pd(step_im);
+	const __m128d v = _mm_set1_pd(volume);
+	__m128d re0 = _mm_loadu_pd(re), re1 = _mm_loadu_pd(re + 2);
+	__m128d im0 = _mm_loadu_pd(im), im1 = _mm_loadu_pd(im + 2);
+	__m128d t0, t1;
+	__m128i s;
+	size_t j;
+
+	for (j = 0; j + KERNELS_TONE_LANES <= n; j += KERNELS_TONE_LANES) {
+		s = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(v, im0)), _mm_cvttpd_epi32(_mm_mul_pd(v, im1)));
+		_mm_storel_epi64((__m128i *) (dst + j), _mm_packs_epi32(s, s));
+		t0 = _mm_sub_pd(_mm_mul_pd(re0, sr), _mm_mul_pd(im0, si));
+		t1 = _mm_sub_pd(_mm_mul_pd(re1, sr), _mm_mul_pd(im1, si));
+		im0 = _mm_add_pd(_mm_mul_pd(re0, si), _mm_mul_pd(im0, sr));
+		im1 = _mm_add_pd(_mm_mul_pd(re1, si), _mm_mul_pd(im1, sr));
+		re0 = t0;
+		re1 = t1;
+	}
+	_mm_storeu_pd(re, re0);	_mm_storeu_pd(re + 2, re1);
+	_mm_storeu_pd(im, im0);	_mm_storeu_pd(im + 2, im1);
+	kernels_phasor_scalar(dst + j, n - j, re, im, step_re, step_im, volume);
+}
+
+__attribute__((target("avx2")))
+static void kernels_widen_avx2(int32_t *dst, const int16_t *src, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i))));
+	}
+	kernels_widen_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void kernels_copy_avx2(int16_t *dst, const int16_t *src, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_loadu_si256((const __m256i *) (src + i)));
+	}
+	kernels_copy_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void kernels_zero_avx2(int16_t *dst, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_setzero_si256());
+	}
+	kernels_zero_scalar(dst + i, n - i);
+}
+
+/* all four lanes in one register */
+__attribute__((target("avx2")))
+static void kernels_phasor_avx2(int16_t *dst, size_t n, double re[KERNELS_TONE_LANES], double im[KERNELS_TONE_LANES], double step_re, double step_im, double volume) {
+	const __m256d sr = _mm256_set1_pd(step_re);
+	const __m256d si = _mm256_set1_pd(step_im);
+	const __m256d v = _mm256_set1_pd(volume);
+	__m256d r = _mm256_loadu_pd(re);
+	__m256d x = _mm256_loadu_pd(im);
+	__m256d t;
+	__m128i s;
+	size_t j;
+
+	for (j = 0; j + KERNELS_TONE_LANES <= n; j += KERNELS_TONE_LANES) {
+		s = _mm256_cvttpd_epi32(_mm256_mul_pd(v, x));
+		_mm_storel_epi64((__m128i *) (dst + j), _mm_packs_epi32(s, s));
+		t = _mm256_sub_pd(_mm256_mul_pd(r, sr), _mm256_mul_pd(x, si));
+		x = _mm256_add_pd(_mm256_mul_pd(r, si), _mm256_mul_pd(x, sr));
+		r = t;
+	}
+	_mm256_storeu_pd(re, r);
+	_mm256_storeu_pd(im, x);
+	kernels_phasor_scalar(dst + j, n - j, re, im, step_re, step_im, volume);
+}
+
+__attribute__((target("avx512f")))
+static void kernels_widen_avx512(int32_t *dst, const int16_t *src, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		_mm512_storeu_si512((void *) (dst + i), _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) (src + i))));
+	}
+	kernels_widen_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void kernels_copy_avx512(int16_t *dst, const int16_t *src, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		_mm512_storeu_si512((void *) (dst + i), _mm512_loadu_si512((const void *) (src + i)));
+	}
+	kernels_copy_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void kernels_zero_avx512(int16_t *dst, size_t n) {
+	size_t i;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		_mm512_storeu_si512((void *) (dst + i), _mm512_setzero_si512());
+	}
+	kernels_zero_scalar(dst + i, n - i);
+}
+
+#endif
+
+static const struct kernels kernels_levels[KERNELS_LEVELS] = {
+	{ "scalar", kernels_widen_scalar, kernels_copy_scalar, kernels_zero_scalar, kernels_phasor_scalar },
+#ifdef KERNELS_X86
+	{ "sse2", kernels_widen_sse2, kernels_copy_sse2, kernels_zero_sse2, kernels_phasor_sse2 },
+	{ "avx2", kernels_widen_avx2, kernels_copy_avx2, kernels_zero_avx2, kernels_phasor_avx2 },
+	{ "avx512", kernels_widen_avx512, kernels_copy_avx512, kernels_zero_avx512, kernels_phasor_avx2 },
+#endif
+};
+
+static const struct kernels *kernels_best = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/* the kernels for KERNELS_* `level`, or NULL if this CPU (or build) doesn't have them */
+const struct kernels *kernels_level(int level) {
+	if (level < 0 || level >= KERNELS_LEVELS || kernels_levels[level].name == NULL) {
+		return NULL;
+	}
+
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+	if ((level == KERNELS_SSE2 && !__builtin_cpu_supports("sse2"))
+			|| (level == KERNELS_AVX2 && !__builtin_cpu_supports("avx2"))
+			|| (level == KERNELS_AVX512 && !__builtin_cpu_supports("avx512f"))) {
+		return NULL;
+	}
+#endif
+
+	return &kernels_levels[level];
+}
+
+static void kernels_select(void) {
+	int level;
+
+	for (level = KERNELS_LEVELS - 1; kernels_best == NULL; level--) {
+		kernels_best = kernels_level(level);
+	}
+}
+
+/* the fastest kernels this CPU runs */
+const struct kernels *kernels_get(void) {
+	pthread_once(&kernels_once, kernels_select);
+	return kernels_best;
+}
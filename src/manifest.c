@@ -0,0 +1,118 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "encoder.h"
+#include "frames.h"
+#include "manifest.h"
+#include "tone.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Render manifest, saved next to an output so a later run can reuse its
+ * frames. Plain text header, the raw input text, then one line per frame:
+ *
+ *   text-to-morse-manifest 2
+ *   wpm 18 fwpm 18 tone 600 envelope linear rate 8000 samples 123456
+ *   text 42
+ *   <42 bytes of input text>
+ *   frames 31
+ *   <byte offset> <bytes> <first sample> <samples>
+ *   ...
+ */
+
+int manifest_write(char *filepath, struct manifest *m) {
+	FILE *out;
+	size_t i;
+
+	out = fopen(filepath, "w");
+	if (out == NULL) {
+		return -1;
+	}
+
+	fprintf(out, "text-to-morse-manifest %d\n", MANIFEST_VERSION);
+	fprintf(out, "wpm %d fwpm %d tone %d envelope %s rate %d samples %" PRIu64 "\n", m->wpm, m->fwpm, m->frequency,
+		m->envelope == TONE_ENVELOPE_COSINE ? "cosine" : "linear", SAMPLE_RATE, m->total_samples);
+	fprintf(out, "text %zu\n", m->text_len);
+	fwrite(m->text, 1, m->text_len, out);
+	fprintf(out, "\nframes %zu\n", m->frames.len);
+	for (i = 0; i < m->frames.len; i++) {
+		struct frame *f = &m->frames.frames[i];
+		fprintf(out, "%" PRIu64 " %" PRIu32 " %" PRIu64 " %" PRIu32 "\n", f->offset, f->bytes, f->sample, f->samples);
+	}
+
+	return fclose(out) == 0 ? 0 : -1;
+}
+
+int manifest_read(char *filepath, struct manifest *m) {
+	FILE *in;
+	int version;
+	int rate;
+	char envelope[16];
+	size_t nframes;
+	size_t i;
+	uint64_t offset, sample;
+	uint32_t bytes, samples;
+	int ok = 1;
+
+	memset(m, 0, sizeof(struct manifest));
+
+	in = fopen(filepath, "r");
+	if (in == NULL) {
+		return -1;
+	}
+
+	ok &= fscanf(in, "text-to-morse-manifest %d\n", &version) == 1 && version == MANIFEST_VERSION;
+	ok &= ok && fscanf(in, "wpm %d fwpm %d tone %d envelope %15s rate %d samples %" SCNu64 "\n", &m->wpm, &m->fwpm, &m->frequency, envelope, &rate, &m->total_samples) == 6 && rate == SAMPLE_RATE;
+	ok &= ok && (m->envelope = tone_envelope_parse(envelope)) != -1;
+	ok &= ok && fscanf(in, "text %zu", &m->text_len) == 1 && fgetc(in) == '\n';
+
+	if (ok) {
+		m->text = (unsigned char *) malloc(m->text_len + 1);
+		ok &= m->text != NULL && fread(m->text, 1, m->text_len, in) == m->text_len;
+	}
+
+	ok &= ok && fscanf(in, "\nframes %zu\n", &nframes) == 1;
+	for (i = 0; ok && i < nframes; i++) {
+		ok &= fscanf(in, "%" SCNu64 " %" SCNu32 " %" SCNu64 " %" SCNu32 "\n", &offset, &bytes, &sample, &samples) == 4;
+		if (ok) {
+			frames_add(&m->frames, offset, bytes, sample, samples);
+		}
+	}
+
+	fclose(in);
+
+	if (!ok) {
+		manifest_free(m);
+		return -1;
+	}
+
+	return 0;
+}
+
+void manifest_free(struct manifest *m) {
+	free(m->text);
+	frames_free(&m->frames);
+	memset(m, 0, sizeof(struct manifest));
+}
@@ -0,0 +1,165 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * MD5 as described in RFC 1321. FLAC stores the MD5 of the decoded audio
+ * in STREAMINFO; this is used when a stream is put together from frames
+ * rather than produced by libFLAC's encoder.
+ */
+
+#include "md5.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint32_t md5_k[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int md5_r[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static void md5_transform(uint32_t state[4], const unsigned char block[64]) {
+	uint32_t w[16];
+	uint32_t a, b, c, d, f, t;
+	int g;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = (uint32_t) block[i*4] | ((uint32_t) block[i*4+1] << 8) | ((uint32_t) block[i*4+2] << 16) | ((uint32_t) block[i*4+3] << 24);
+	}
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+
+	for (i = 0; i < 64; i++) {
+		if (i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if (i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) % 16;
+		} else if (i < 48) {
+			f = b ^ c ^ d;
+			g = (3 * i + 5) % 16;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7 * i) % 16;
+		}
+
+		t = d;
+		d = c;
+		c = b;
+		f = a + f + md5_k[i] + w[g];
+		b = b + ((f << md5_r[i]) | (f >> (32 - md5_r[i])));
+		a = t;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+void md5_init(struct md5 *ctx) {
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+	ctx->len = 0;
+}
+
+void md5_update(struct md5 *ctx, const void *data, size_t len) {
+	const unsigned char *p = (const unsigned char *) data;
+	size_t used = ctx->len % 64;
+	size_t n;
+
+	ctx->len += len;
+
+	if (used > 0) {
+		n = 64 - used < len ? 64 - used : len;
+		memcpy(ctx->block + used, p, n);
+		p += n;
+		len -= n;
+		if (used + n < 64) {
+			return;
+		}
+		md5_transform(ctx->state, ctx->block);
+	}
+
+	while (len >= 64) {
+		md5_transform(ctx->state, p);
+		p += 64;
+		len -= 64;
+	}
+
+	memcpy(ctx->block, p, len);
+}
+
+/* hash samples the way FLAC does: signed 16-bit little endian */
+void md5_update_samples(struct md5 *ctx, const int16_t *samples, size_t nsamples) {
+	unsigned char buf[1024];
+	size_t i;
+	size_t n;
+
+	while (nsamples > 0) {
+		n = nsamples < sizeof(buf) / 2 ? nsamples : sizeof(buf) / 2;
+		for (i = 0; i < n; i++) {
+			buf[2*i] = (uint16_t) samples[i] & 0xff;
+			buf[2*i+1] = ((uint16_t) samples[i] >> 8) & 0xff;
+		}
+		md5_update(ctx, buf, n * 2);
+		samples += n;
+		nsamples -= n;
+	}
+}
+
+void md5_final(struct md5 *ctx, unsigned char digest[16]) {
+	static const unsigned char pad[64] = { 0x80 };
+	unsigned char bits[8];
+	uint64_t len = ctx->len * 8;
+	size_t used = ctx->len % 64;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		bits[i] = (len >> (i * 8)) & 0xff;
+	}
+
+	md5_update(ctx, pad, used < 56 ? 56 - used : 120 - used);
+	md5_update(ctx, bits, 8);
+
+	for (i = 0; i < 16; i++) {
+		digest[i] = (ctx->state[i / 4] >> ((i % 4) * 8)) & 0xff;
+	}
+}
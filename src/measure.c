@@ -0,0 +1,96 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "measure.h"
+#include "morse.h"
+
+#include <stdlib.h>
+
+/*
+ * Work out the length of every character in `morse_alphabet` from the
+ * lengths of the elements it is built from. Mirrors render_character().
+ */
+void measure_init(struct measure *m, size_t dit, size_t dah, size_t intra_character, size_t inter_character, size_t inter_word) {
+	int c;
+	int i;
+
+	m->inter_character = inter_character;
+
+	for (c = 0; c < 256; c++) {
+		const char *s = morse_alphabet[c];
+		size_t n = 0;
+		size_t t = 0;
+
+		for (i = 0; s[i] != '\0'; i++) {
+			if (i != 0) {
+				n += intra_character;
+			}
+			switch (s[i]) {
+				case ' ':
+					n += inter_word;
+					break;
+				case '.':
+					n += dit;
+					t += dit;
+					break;
+				case '-':
+					n += dah;
+					t += dah;
+					break;
+			}
+		}
+
+		m->character[c] = n;
+		m->tone[c] = t;
+	}
+}
+
+/*
+ * Samples needed to render `len` bytes of `text`. `first` is the position
+ * of text[0] in the whole input; every byte but the very first one is
+ * preceded by an inter-character space.
+ */
+size_t measure_text(const struct measure *m, const unsigned char *text, size_t len, size_t first) {
+	size_t i;
+	size_t n = 0;
+
+	for (i = 0; i < len; i++) {
+		n += m->character[text[i]];
+	}
+
+	n += m->inter_character * len;
+	if (first == 0 && len > 0) {
+		n -= m->inter_character;
+	}
+
+	return n;
+}
+
+/* Samples of tone (as opposed to silence) in `len` bytes of `text`. */
+size_t measure_tone(const struct measure *m, const unsigned char *text, size_t len) {
+	size_t i;
+	size_t n = 0;
+
+	for (i = 0; i < len; i++) {
+		n += m->tone[text[i]];
+	}
+
+	return n;
+}
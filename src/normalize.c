@@ -0,0 +1,208 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Input clean-up before rendering. Every byte after the first gets an
+ * inter-character space, even bytes with no Morse code, so tabs, CRs and
+ * unknown punctuation used to turn into stretches of silence. This pass
+ * folds lowercase to uppercase, drops (or substitutes) bytes that have no
+ * Morse code and collapses each run of whitespace into a single word gap
+ * ('\n' if the run holds one, so line starts survive, ' ' otherwise).
+ * Leading and trailing whitespace is dropped.
+ *
+ * Runs of 16 letters and digits with single spaces between them are the
+ * common case; with SSE2 those are recognized and copied 16 bytes at a
+ * time, everything else goes byte by byte.
+ */
+
+#include "morse.h"
+#include "normalize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* byte classes */
+#define NORMALIZE_DROP (0)
+#define NORMALIZE_SYMBOL (1)
+#define NORMALIZE_SPACE (2)
+
+static int enabled = 0;
+static int substitute = -1;	/* replacement for unmappable bytes, -1 drops them */
+static unsigned char fold[256];
+static unsigned char class[256];
+static int ready = 0;
+static int blocks = 0;	/* the 16 byte path is usable: A-Z and 0-9 all have codes */
+
+static int normalize_whitespace(int c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static void normalize_tables(void) {
+	int c;
+
+	for (c = 0; c < 256; c++) {
+		fold[c] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+
+		if (normalize_whitespace(c)) {
+			class[c] = NORMALIZE_SPACE;
+		} else if (morse_alphabet[fold[c]][0] != '\0') {
+			class[c] = NORMALIZE_SYMBOL;
+		} else if (substitute != -1) {
+			fold[c] = substitute;
+			class[c] = NORMALIZE_SYMBOL;
+		} else {
+			class[c] = NORMALIZE_DROP;
+		}
+	}
+
+	blocks = 1;
+	for (c = 0; c < 256; c++) {
+		if (((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) && morse_alphabet[c][0] == '\0') {
+			blocks = 0;
+		}
+	}
+
+	ready = 1;
+}
+
+/*
+ * Turn the prepass on. `sub` replaces unmappable bytes, -1 drops them.
+ * Returns -1 if `sub` has no morse code itself.
+ */
+int normalize_enable(int sub) {
+	if (sub != -1 && (morse_alphabet[sub][0] == '\0' || normalize_whitespace(sub))) {
+		return -1;
+	}
+
+	enabled = 1;
+	substitute = sub;
+	ready = 0;
+
+	return 0;
+}
+
+int normalize_is_enabled(void) { return enabled; }
+
+void normalize_init(struct normalize *st) {
+	memset(st, 0, sizeof(struct normalize));
+	if (!ready) {
+		normalize_tables();
+	}
+}
+
+#ifdef __SSE2__
+/*
+ * If the 16 bytes at `src` are letters and digits with only single spaces
+ * between them, write them case folded to `dst` and return 1.
+ */
+static int normalize_block(unsigned char *dst, const unsigned char *src) {
+	const __m128i v = _mm_loadu_si128((const __m128i *) src);
+	const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+	const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+	const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+	const __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+	int spaces = _mm_movemask_epi8(space);
+	int ok = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(lower, upper), _mm_or_si128(digit, space)));
+
+	/* spaces must sit between two symbols inside the block */
+	if (ok != 0xffff || (spaces & 0x8001) != 0 || (spaces & (spaces >> 1)) != 0) {
+		return 0;
+	}
+
+	_mm_storeu_si128((__m128i *) dst, _mm_sub_epi8(v, _mm_and_si128(lower, _mm_set1_epi8(0x20))));
+
+	return 1;
+}
+#endif
+
+/*
+ * Normalize `len` bytes of `src` into `dst`, which needs room for len + 1
+ * bytes (a whitespace run held back from the previous chunk may come out
+ * first). Returns the number of bytes written. Nothing is written past
+ * the byte being read, so `dst` may be `src` - 1, or `src` itself on a
+ * fresh `st`.
+ */
+size_t normalize(struct normalize *st, unsigned char *dst, const unsigned char *src, size_t len) {
+	size_t n = 0;
+	size_t i = 0;
+	unsigned char c;
+
+	while (i < len) {
+#ifdef __SSE2__
+		/* letters, digits and single spaces; the 16 bytes go out as they are */
+		if (blocks && i + 16 <= len && normalize_block(dst + n + (st->pending ? 1 : 0), src + i)) {
+			if (st->pending) {
+				dst[n++] = st->pending;
+				st->pending = 0;
+			}
+			st->started = 1;
+			n += 16;
+			i += 16;
+			continue;
+		}
+#endif
+		c = src[i];
+		switch (class[c]) {
+			case NORMALIZE_SPACE:
+				if (st->started) {
+					st->pending = (st->pending == '\n' || c == '\n') ? '\n' : ' ';
+				}
+				break;
+			case NORMALIZE_SYMBOL:
+				if (st->pending) {
+					dst[n++] = st->pending;
+					st->pending = 0;
+				}
+				dst[n++] = fold[c];
+				st->started = 1;
+				break;
+		}
+		i++;
+	}
+
+	return n;
+}
+
+/*
+ * fread() for the chunked readers: fill `dst` with up to `cap` bytes of
+ * `input`, normalized when the prepass is on. Only returns 0 at the end of
+ * the input (or on a read error), even if whole chunks normalize away.
+ */
+size_t normalize_fread(struct normalize *st, unsigned char *dst, size_t cap, FILE *input) {
+	size_t n = 0;
+	size_t got;
+
+	if (!enabled) {
+		return fread(dst, 1, cap, input);
+	}
+
+	/* read one byte in so the held back whitespace fits in front */
+	while (n == 0 && (got = fread(dst + 1, 1, cap - 1, input)) > 0) {
+		n = normalize(st, dst, dst + 1, got);
+	}
+
+	return n;
+}
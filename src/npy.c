@@ -0,0 +1,219 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * NumPy .npy export for training data: the rendered audio as a float32
+ * (or int16) array, and next to it clip.labels.npy with where every
+ * character and element is, in samples, so a loader can np.load(...,
+ * mmap_mode='r') both without decoding anything.
+ *
+ * The labels are a structured array of (start, end, kind, char): int64
+ * sample offsets (end exclusive), NPY_LABEL_* and the input byte. Each
+ * character's record comes first, then one per dit and dah of it. The
+ * offsets are worked out with the renderer's element lengths, the same way
+ * as key events, so they match the audio exactly.
+ */
+
+#include "bytes.h"
+#include "morse.h"
+#include "npy.h"
+#include "nsamples.h"
+#include "output.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NPY_WRITESIZE (16 * 1024)	/* samples converted at a time */
+#define NPY_LABEL_SIZE (18)		/* bytes per label record */
+
+/* magic, version 1.0 and the header describing `descr` x `n`, padded so the data is aligned */
+static int npy_header(struct output *out, const char *descr, size_t n) {
+	char hdr[256];
+	int len;
+
+	len = snprintf(hdr + 10, sizeof(hdr) - 10 - NPY_ALIGN, "{'descr': %s, 'fortran_order': False, 'shape': (%zu,), }", descr, n);
+	while ((10 + len + 1) % NPY_ALIGN != 0) {
+		hdr[10 + len++] = ' ';
+	}
+	hdr[10 + len++] = '\n';
+
+	memcpy(hdr, "\x93NUMPY\x01\x00", 8);
+	bytes_put_le((unsigned char *) hdr + 8, len, 2);
+
+	return output_write(out, hdr, 10 + len);
+}
+
+/* write `len` samples as a 1-D array of NPY_FLOAT32 or NPY_INT16 */
+int npy_write(char *filepath, const int16_t *samples, size_t len, int format) {
+	unsigned char *buf;
+	struct output *out;
+	uint32_t bits;
+	float f;
+	size_t i;
+	size_t n;
+	int ok = 1;
+
+	out = output_open(filepath);
+	if (out == NULL) {
+		fprintf(stderr, "Could not open output file '%s'\n", filepath);
+		return -1;
+	}
+
+	ok &= npy_header(out, format == NPY_INT16 ? "'<i2'" : "'<f4'", len) == 0;
+
+	buf = (unsigned char *) malloc(NPY_WRITESIZE * 4);
+	if (buf == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	while (ok && len > 0) {
+		n = len < NPY_WRITESIZE ? len : NPY_WRITESIZE;
+		if (format == NPY_INT16) {
+			for (i = 0; i < n; i++) {
+				bytes_put_le(buf + 2 * i, (uint16_t) samples[i], 2);
+			}
+			ok &= output_write(out, buf, n * 2) == 0;
+		} else {
+			for (i = 0; i < n; i++) {
+				f = samples[i] / 32768.0f;
+				memcpy(&bits, &f, sizeof(bits));
+				bytes_put_le(buf + 4 * i, bits, 4);
+			}
+			ok &= output_write(out, buf, n * 4) == 0;
+		}
+		samples += n;
+		len -= n;
+	}
+	free(buf);
+
+	ok &= output_close(out) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write output file '%s'\n", filepath);
+	}
+
+	return ok ? 0 : -1;
+}
+
+/* clip.npy -> clip.labels.npy */
+static char *npy_labels_name(const char *filepath) {
+	size_t stem = strlen(filepath);
+	char *name;
+
+	if (stem >= 4 && strcmp(filepath + stem - 4, ".npy") == 0) {
+		stem -= 4;
+	}
+
+	name = (char *) malloc(stem + strlen(".labels.npy") + 1);
+	if (name == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(name, "%.*s.labels.npy", (int) stem, filepath);
+
+	return name;
+}
+
+static int npy_label(struct output *out, uint64_t start, uint64_t end, int kind, unsigned char c) {
+	unsigned char rec[NPY_LABEL_SIZE];
+
+	bytes_put_le(rec, start, 8);
+	bytes_put_le(rec + 8, end, 8);
+	rec[16] = kind;
+	rec[17] = c;
+
+	return output_write(out, rec, sizeof(rec));
+}
+
+/* write the labels for `text` at `wpm`/`fwpm` next to the audio array `filepath` */
+int npy_write_labels(char *filepath, const unsigned char *text, size_t len, int wpm, int fwpm) {
+	const uint64_t dit = nsamples_dit(wpm);
+	const uint64_t dah = nsamples_dah(wpm);
+	const uint64_t intra_character = nsamples_intra_character_space(wpm);
+	const uint64_t inter_character = nsamples_inter_character_space(fwpm);
+	const uint64_t inter_word = nsamples_inter_word_space(fwpm);
+	struct output *out;
+	char *name;
+	const char *s;
+	uint64_t pos = 0;
+	uint64_t start;
+	size_t n = 0;
+	size_t i;
+	int j;
+	int ok = 1;
+
+	/* the header holds the number of records */
+	for (i = 0; i < len; i++) {
+		s = morse_alphabet[text[i]];
+		for (j = 0; s[j] != '\0'; j++) {
+			n += s[j] == '.' || s[j] == '-';
+		}
+		n += s[0] != '\0';
+	}
+
+	name = npy_labels_name(filepath);
+	out = output_open(name);
+	if (out == NULL) {
+		fprintf(stderr, "Could not open output file '%s'\n", name);
+		free(name);
+		return -1;
+	}
+
+	ok &= npy_header(out, "[('start', '<i8'), ('end', '<i8'), ('kind', 'u1'), ('char', 'u1')]", n) == 0;
+
+	for (i = 0; ok && i < len; i++) {
+		s = morse_alphabet[text[i]];
+
+		pos += i != 0 ? inter_character : 0;
+		if (s[0] == '\0') {
+			continue;
+		}
+
+		/* the character's extent first, then its elements */
+		start = pos;
+		for (j = 0; s[j] != '\0'; j++) {
+			pos += j != 0 ? intra_character : 0;
+			pos += s[j] == ' ' ? inter_word : s[j] == '.' ? dit : s[j] == '-' ? dah : 0;
+		}
+		ok &= npy_label(out, start, pos, NPY_LABEL_CHARACTER, text[i]) == 0;
+
+		pos = start;
+		for (j = 0; s[j] != '\0'; j++) {
+			pos += j != 0 ? intra_character : 0;
+			if (s[j] == '.') {
+				ok &= npy_label(out, pos, pos + dit, NPY_LABEL_DIT, text[i]) == 0;
+			} else if (s[j] == '-') {
+				ok &= npy_label(out, pos, pos + dah, NPY_LABEL_DAH, text[i]) == 0;
+			}
+			pos += s[j] == ' ' ? inter_word : s[j] == '.' ? dit : s[j] == '-' ? dah : 0;
+		}
+	}
+
+	ok &= output_close(out) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write output file '%s'\n", name);
+	}
+	free(name);
+
+	return ok ? 0 : -1;
+}
@@ -0,0 +1,475 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define _GNU_SOURCE	/* memfd_create(), F_ADD_SEALS */
+
+#include "output.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/*
+ * Buffered output for the encoder. Writes are collected into fixed size
+ * buffers. With io_uring each full buffer is submitted as an asynchronous
+ * write and the encoder only waits when every buffer is in flight. Without
+ * io_uring (not compiled in, or the kernel refuses to set up a ring) the
+ * buffers are written out with ordinary pwrite() calls. Either way the
+ * file is fsync()ed before it's closed.
+ *
+ * Buffers are allocated the first time they are filled, and a finished
+ * one is reused before a new one is touched, so a short output or a slow
+ * encoder only ever holds one or two however deep the queue is.
+ */
+
+struct output_buf {
+	unsigned char *data;
+	size_t len;
+	uint64_t offset;
+	int busy;	/* submitted, waiting for completion */
+};
+
+struct output {
+	int fd;
+	int seal;	/* seal the file when it's complete: fd:N and memfd:N */
+	int handoff;	/* unix socket to send the file to when it's complete, or -1 */
+	int error;
+	uint64_t offset;
+	struct output_buf *bufs;
+	int nbufs;
+	int cur;
+#ifdef HAVE_LIBURING
+	int uring;
+	int inflight;
+	struct io_uring ring;
+#endif
+};
+
+static int queue_depth = OUTPUT_QUEUE_DEPTH;
+
+void output_set_queue_depth(int depth)	{ queue_depth = depth; }
+int output_get_queue_depth(void)	{ return queue_depth; }
+
+/* write all of `data` at `offset`, retrying on short writes */
+static int output_pwrite(int fd, const unsigned char *data, size_t len, uint64_t offset) {
+	while (len > 0) {
+		ssize_t n = pwrite(fd, data, len, offset);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		data += n;
+		len -= n;
+		offset += n;
+	}
+	return 0;
+}
+
+#ifdef HAVE_LIBURING
+/* account for one finished request; `b` is NULL for the final fsync */
+static void output_complete(struct output *out, struct output_buf *b, int res) {
+	out->inflight--;
+	if (res < 0) {
+		out->error = 1;
+	} else if (b != NULL && (size_t) res < b->len) {
+		/* short write, finish it synchronously */
+		if (output_pwrite(out->fd, b->data + res, b->len - res, b->offset + res) == -1) {
+			out->error = 1;
+		}
+	}
+	if (b != NULL) {
+		b->busy = 0;
+		b->len = 0;
+	}
+}
+
+/* harvest completions, blocking for at least one if `wait` is set */
+static int output_reap(struct output *out, int wait) {
+	struct io_uring_cqe *cqe;
+	int rc;
+
+	while (out->inflight > 0) {
+		rc = wait ? io_uring_wait_cqe(&out->ring, &cqe) : io_uring_peek_cqe(&out->ring, &cqe);
+		if (rc == -EINTR) {
+			continue;
+		} else if (rc != 0) {
+			if (wait) {
+				out->error = 1;
+				return -1;
+			}
+			break;
+		}
+		output_complete(out, (struct output_buf *) io_uring_cqe_get_data(cqe), cqe->res);
+		io_uring_cqe_seen(&out->ring, cqe);
+		wait = 0;
+	}
+	return 0;
+}
+
+/* wait for every submitted request to finish */
+static void output_drain(struct output *out) {
+	while (out->inflight > 0) {
+		if (output_reap(out, 1) == -1) {
+			break;
+		}
+	}
+}
+
+/* queue the current buffer and move on to a free one */
+static int output_submit(struct output *out) {
+	struct output_buf *b = &out->bufs[out->cur];
+	struct io_uring_sqe *sqe;
+	int i;
+
+	sqe = io_uring_get_sqe(&out->ring);
+	if (sqe == NULL) {
+		return -1;
+	}
+	io_uring_prep_write(sqe, out->fd, b->data, b->len, b->offset);
+	io_uring_sqe_set_data(sqe, b);
+	if (io_uring_submit(&out->ring) < 0) {
+		return -1;
+	}
+	b->busy = 1;
+	out->inflight++;
+
+	output_reap(out, 0);
+	for (;;) {
+		for (i = 0; i < out->nbufs; i++) {
+			if (out->bufs[i].busy == 0) {
+				out->cur = i;
+				return 0;
+			}
+		}
+		if (output_reap(out, 1) == -1) {
+			return -1;
+		}
+	}
+}
+#endif
+
+/* hand the buffer being filled to the backend */
+static int output_flush(struct output *out) {
+	struct output_buf *b = &out->bufs[out->cur];
+
+	if (b->len == 0) {
+		return out->error ? -1 : 0;
+	}
+#ifdef HAVE_LIBURING
+	if (out->uring) {
+		if (output_submit(out) == -1) {
+			out->error = 1;
+		}
+		return out->error ? -1 : 0;
+	}
+#endif
+	if (output_pwrite(out->fd, b->data, b->len, b->offset) == -1) {
+		out->error = 1;
+	}
+	b->len = 0;
+
+	return out->error ? -1 : 0;
+}
+
+/* the N of "fd:N" or "memfd:N", -1 if `filepath` doesn't start with `prefix` */
+static int output_descriptor(const char *filepath, const char *prefix) {
+	size_t len = strlen(prefix);
+	char *end;
+	long n;
+
+	if (strncmp(filepath, prefix, len) != 0 || filepath[len] < '0' || filepath[len] > '9') {
+		return -1;
+	}
+	n = strtol(filepath + len, &end, 10);
+
+	return *end == '\0' && n <= 65535 ? (int) n : -1;
+}
+
+/*
+ * The name of a file that goes with the output `filepath`: its stem, then
+ * `suffix`, then `ext`, or the output's own extension when `ext` is NULL.
+ * book.flac with "-001" is book-001.flac, with "" and ".segments" it is
+ * book.segments.
+ */
+char *output_name(const char *filepath, const char *suffix, const char *ext) {
+	const char *dot = strrchr(filepath, '.');
+	const char *slash = strrchr(filepath, '/');
+	size_t stem;
+	char *name;
+
+	if (dot == NULL || (slash != NULL && dot < slash)) {
+		dot = filepath + strlen(filepath);
+	}
+	stem = dot - filepath;
+	ext = ext == NULL ? dot : ext;
+
+	name = (char *) malloc(stem + strlen(suffix) + strlen(ext) + 1);
+	if (name == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(name, "%.*s%s%s", (int) stem, filepath, suffix, ext);
+
+	return name;
+}
+
+/* is `filepath` one of the descriptor outputs below rather than a path? */
+int output_is_descriptor(const char *filepath) {
+	return output_descriptor(filepath, "fd:") != -1 || output_descriptor(filepath, "memfd:") != -1;
+}
+
+/*
+ * Open `filepath` for writing. Besides a path this can be:
+ *
+ *   fd:N     descriptor N, inherited from the parent (a regular file or a
+ *            memfd; it has to be seekable), truncated first and sealed
+ *            against changes once it's complete if it allows sealing.
+ *   memfd:N  a new anonymous memfd, sealed once complete and sent with
+ *            SCM_RIGHTS over the unix socket inherited as descriptor N,
+ *            along with its length as a little-endian 64-bit integer.
+ *
+ * Either way the audio never touches the filesystem and the parent can
+ * mmap() it safely once it has it.
+ */
+struct output *output_open(char *filepath) {
+	struct output *out;
+	int fd;
+
+	out = (struct output *) calloc(1, sizeof(struct output));
+	if (out == NULL) {
+		return NULL;
+	}
+	out->handoff = -1;
+
+	if ((fd = output_descriptor(filepath, "fd:")) != -1) {
+		out->fd = fd;
+		out->seal = 1;
+		if (ftruncate(out->fd, 0) == -1) {
+			free(out);
+			return NULL;
+		}
+	} else if ((fd = output_descriptor(filepath, "memfd:")) != -1) {
+		out->handoff = fd;
+		out->seal = 1;
+		out->fd = memfd_create("text-to-morse", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	} else {
+		out->fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	}
+	if (out->fd == -1) {
+		free(out);
+		return NULL;
+	}
+
+	out->nbufs = 1;
+#ifdef HAVE_LIBURING
+	if (queue_depth > 0 && io_uring_queue_init(queue_depth, &out->ring, 0) == 0) {
+		out->uring = 1;
+		out->nbufs = queue_depth;
+	}
+#endif
+
+	out->bufs = (struct output_buf *) calloc(out->nbufs, sizeof(struct output_buf));
+	if (out->bufs == NULL) {
+		output_close(out);
+		return NULL;
+	}
+
+	return out;
+}
+
+int output_write(struct output *out, const void *data, size_t len) {
+	const unsigned char *p = (const unsigned char *) data;
+	struct output_buf *b;
+	size_t n;
+
+	while (len > 0) {
+		b = &out->bufs[out->cur];
+		if (b->data == NULL) {
+			b->data = (unsigned char *) malloc(OUTPUT_BUFFER_SIZE);
+			if (b->data == NULL) {
+				out->error = 1;
+				return -1;
+			}
+		}
+		if (b->len == 0) {
+			b->offset = out->offset;
+		}
+
+		n = OUTPUT_BUFFER_SIZE - b->len;
+		n = len < n ? len : n;
+		memcpy(b->data + b->len, p, n);
+		b->len += n;
+		out->offset += n;
+		p += n;
+		len -= n;
+
+		if (b->len == OUTPUT_BUFFER_SIZE && output_flush(out) == -1) {
+			return -1;
+		}
+	}
+
+	return out->error ? -1 : 0;
+}
+
+/*
+ * Move the write position. Everything queued so far is completed first so
+ * that rewriting an earlier region (e.g. STREAMINFO) can't race with the
+ * original write of the same bytes.
+ */
+int output_seek(struct output *out, uint64_t offset) {
+	if (output_flush(out) == -1) {
+		return -1;
+	}
+#ifdef HAVE_LIBURING
+	if (out->uring) {
+		output_drain(out);
+	}
+#endif
+	out->offset = offset;
+
+	return out->error ? -1 : 0;
+}
+
+uint64_t output_tell(struct output *out) {
+	return out->offset;
+}
+
+/* no more changes of any kind; a descriptor that can't be sealed is left as it is */
+static int output_seal(int fd) {
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1 && errno != EINVAL && errno != EPERM) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* send `fd` and its length `len` over the unix socket `sock` */
+static int output_send(int sock, int fd, uint64_t len) {
+	unsigned char payload[8];
+	char control[CMSG_SPACE(sizeof(int))];
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t n;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		payload[i] = len >> (8 * i);
+	}
+	iov.iov_base = payload;
+	iov.iov_len = sizeof(payload);
+
+	memset(&msg, 0, sizeof(struct msghdr));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	while ((n = sendmsg(sock, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR);
+
+	return n == (ssize_t) sizeof(payload) ? 0 : -1;
+}
+
+/*
+ * Write out anything pending, fsync() and close the file. With io_uring
+ * the fsync is queued behind the last write and the ring is drained once
+ * at the end; otherwise, or if it couldn't be queued, it's done here.
+ */
+int output_close(struct output *out) {
+	int synced = 0;
+	int i;
+	int rc;
+
+	if (out->bufs != NULL) {
+		output_flush(out);
+	}
+
+#ifdef HAVE_LIBURING
+	if (out->uring) {
+		struct io_uring_sqe *sqe;
+
+		sqe = io_uring_get_sqe(&out->ring);
+		if (sqe != NULL) {
+			io_uring_prep_fsync(sqe, out->fd, 0);
+			io_uring_sqe_set_flags(sqe, IOSQE_IO_DRAIN);
+			io_uring_sqe_set_data(sqe, NULL);
+			if (io_uring_submit(&out->ring) > 0) {
+				out->inflight++;
+				synced = 1;
+			}
+		}
+		output_drain(out);
+		io_uring_queue_exit(&out->ring);
+	}
+#endif
+
+	/* EINVAL: a descriptor that has nothing to sync */
+	if (!out->error && out->bufs != NULL && !synced && fsync(out->fd) == -1 && errno != EINVAL) {
+		out->error = 1;
+	}
+
+	if (!out->error && out->seal && output_seal(out->fd) == -1) {
+		out->error = 1;
+	}
+	if (!out->error && out->handoff != -1) {
+		struct stat st;
+
+		if (fstat(out->fd, &st) == -1 || output_send(out->handoff, out->fd, st.st_size) == -1) {
+			out->error = 1;
+		}
+	}
+
+	if (close(out->fd) == -1) {
+		out->error = 1;
+	}
+
+	if (out->bufs != NULL) {
+		for (i = 0; i < out->nbufs; i++) {
+			free(out->bufs[i].data);
+		}
+		free(out->bufs);
+	}
+
+	rc = out->error ? -1 : 0;
+	free(out);
+
+	return rc;
+}
@@ -0,0 +1,326 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Pipelined conversion: a reader thread, a renderer thread and the
+ * encoder (on the calling thread) run at the same time, so the whole
+ * conversion takes about as long as the slowest of the three instead of
+ * the sum of all of them. Stages hand blocks to the next one over single
+ * producer/single consumer rings and get them back, once consumed, over a
+ * second ring going the other way. Each stage owns a fixed number of
+ * blocks, so a stage that gets ahead waits for the next one to catch up.
+ *
+ *   reader --text--> renderer --samples--> encoder
+ *          <-free---          <--free----
+ *
+ * A block with a length of 0 marks the end of the input.
+ */
+
+#include "align.h"
+#include "encoder.h"
+#include "md5.h"
+#include "measure.h"
+#include "normalize.h"
+#include "pipeline.h"
+#include "render.h"
+#include "ring.h"
+#include "verify.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct pipeline_text {
+	size_t len;
+	unsigned char data[PIPELINE_TEXT_BLOCK];
+};
+
+struct pipeline_samples {
+	size_t len;
+	int16_t data[PIPELINE_SAMPLE_BLOCK];
+};
+
+struct pipeline {
+	FILE *input;
+	unsigned char *whole;	/* all of a regular file's text, read up front, or NULL */
+	size_t whole_len;
+	struct measure m;
+
+	struct ring text_full;
+	struct ring text_free;
+	struct ring samples_full;
+	struct ring samples_free;
+
+	struct pipeline_text text[PIPELINE_DEPTH];
+	struct pipeline_samples samples[PIPELINE_DEPTH];
+
+	int read_error;		/* set by the reader */
+	size_t text_len;	/* set by the renderer */
+};
+
+static void *pipeline_reader(void *arg) {
+	struct pipeline *p = (struct pipeline *) arg;
+	struct pipeline_text *t;
+	struct normalize st;
+
+	size_t pos = 0;
+
+	normalize_init(&st);
+	do {
+		t = (struct pipeline_text *) ring_get(&p->text_free);
+		if (p->whole != NULL) {
+			t->len = p->whole_len - pos < PIPELINE_TEXT_BLOCK ? p->whole_len - pos : PIPELINE_TEXT_BLOCK;
+			memcpy(t->data, p->whole + pos, t->len);
+			pos += t->len;
+		} else {
+			t->len = normalize_fread(&st, t->data, PIPELINE_TEXT_BLOCK, p->input);
+			if (t->len == 0 && ferror(p->input)) {
+				p->read_error = 1;
+			}
+		}
+		ring_put(&p->text_full, t);
+	} while (t->len > 0);
+
+	return NULL;
+}
+
+/* pass the first PIPELINE_SAMPLE_BLOCK samples of `stage` (or `len` if fewer) down the pipeline */
+static void pipeline_emit(struct pipeline *p, const int16_t *stage, size_t len) {
+	struct pipeline_samples *s;
+
+	s = (struct pipeline_samples *) ring_get(&p->samples_free);
+	s->len = len < PIPELINE_SAMPLE_BLOCK ? len : PIPELINE_SAMPLE_BLOCK;
+	memcpy(s->data, stage, s->len * sizeof(int16_t));
+	ring_put(&p->samples_full, s);
+}
+
+/* render each block of text, then cut the samples into blocks for the encoder */
+static void *pipeline_renderer(void *arg) {
+	struct pipeline *p = (struct pipeline *) arg;
+	struct pipeline_text *t;
+	int16_t *stage = NULL;		/* rendered samples not yet passed on */
+	size_t staged = 0;
+	size_t stage_cap = 0;
+	size_t stage_sample = 0;	/* position of stage[0] in the output */
+	size_t first = 0;		/* position of the next byte in the input */
+	size_t done;
+	size_t n;
+	size_t i;
+
+	for (;;) {
+		t = (struct pipeline_text *) ring_get(&p->text_full);
+		if (t->len == 0) {
+			ring_put(&p->text_free, t);
+			break;
+		}
+
+		n = measure_text(&p->m, t->data, t->len, first);
+		if (staged + n > stage_cap) {
+			int16_t *new_stage;
+
+			stage_cap = staged + n > 2 * stage_cap ? staged + n : 2 * stage_cap;
+			new_stage = (int16_t *) realloc(stage, stage_cap * sizeof(int16_t));
+			if (new_stage == NULL) {
+				fprintf(stderr, "malloc failed :(\n");
+				exit(EXIT_FAILURE);
+			}
+			stage = new_stage;
+		}
+		render_span(stage + staged, t->data, t->len, first);
+
+		if (align_is_enabled()) {
+			size_t offset = stage_sample + staged;
+
+			for (i = 0; i < t->len; i++) {
+				offset += first + i != 0 ? p->m.inter_character : 0;
+				align_char(t->data[i], first + i, offset);
+				offset += p->m.character[t->data[i]];
+			}
+		}
+
+		first += t->len;
+		staged += n;
+		ring_put(&p->text_free, t);
+
+		for (done = 0; staged - done >= PIPELINE_SAMPLE_BLOCK; done += PIPELINE_SAMPLE_BLOCK) {
+			pipeline_emit(p, stage + done, PIPELINE_SAMPLE_BLOCK);
+		}
+		memmove(stage, stage + done, (staged - done) * sizeof(int16_t));
+		staged -= done;
+		stage_sample += done;
+	}
+
+	if (staged > 0) {
+		pipeline_emit(p, stage, staged);
+	}
+	pipeline_emit(p, stage, 0);
+
+	p->text_len = first;
+	free(stage);
+
+	return NULL;
+}
+
+/*
+ * The seek table is sized before encoding starts, so a regular file is
+ * read (and normalized) up front and measured; the reader then hands out
+ * that text instead of reading the file again. The text is small next to
+ * the audio it turns into. Other inputs can only be read once and get no
+ * seek table. Returns 0 when the length isn't known.
+ */
+static size_t pipeline_total_samples(struct pipeline *p) {
+	struct stat st;
+	struct normalize nst;
+	size_t cap;
+	size_t n;
+
+	if (fstat(fileno(p->input), &st) == -1 || !S_ISREG(st.st_mode)) {
+		return 0;
+	}
+
+	cap = (size_t) st.st_size + PIPELINE_TEXT_BLOCK;
+	p->whole = (unsigned char *) malloc(cap);
+	if (p->whole == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	normalize_init(&nst);
+	while ((n = normalize_fread(&nst, p->whole + p->whole_len, PIPELINE_TEXT_BLOCK, p->input)) > 0) {
+		p->whole_len += n;
+		if (cap - p->whole_len < PIPELINE_TEXT_BLOCK) {
+			unsigned char *new_whole;
+
+			/* the file grew since fstat() */
+			cap *= 2;
+			new_whole = (unsigned char *) realloc(p->whole, cap);
+			if (new_whole == NULL) {
+				fprintf(stderr, "malloc failed :(\n");
+				exit(EXIT_FAILURE);
+			}
+			p->whole = new_whole;
+		}
+	}
+
+	if (ferror(p->input)) {
+		fprintf(stderr, "Could not read the input\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return measure_text(&p->m, p->whole, p->whole_len, 0);
+}
+
+/*
+ * Read, render and encode `input` to `filepath` with the three stages
+ * running concurrently. The elements must be initialized (tone_init(),
+ * space_init()). The rendered audio isn't kept, render_get_buf() stays
+ * empty; it is verified against its MD5 unless verification is disabled.
+ */
+int pipeline_run(FILE *input, char *filepath, struct pipeline_stats *stats) {
+	struct pipeline *p;
+	struct pipeline_samples *s;
+	struct encoder_stream *es;
+	struct verify *verifier = NULL;
+	struct md5 md5;
+	unsigned char digest[16];
+	pthread_t reader;
+	pthread_t renderer;
+	size_t total = 0;
+	int rc = 0;
+	int i;
+
+	p = (struct pipeline *) calloc(1, sizeof(struct pipeline));
+	if (p == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	p->input = input;
+	render_measure(&p->m);
+
+	if (ring_init(&p->text_full, PIPELINE_DEPTH) == -1 || ring_init(&p->text_free, PIPELINE_DEPTH) == -1 ||
+			ring_init(&p->samples_full, PIPELINE_DEPTH) == -1 || ring_init(&p->samples_free, PIPELINE_DEPTH) == -1) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < PIPELINE_DEPTH; i++) {
+		ring_put(&p->text_free, &p->text[i]);
+		ring_put(&p->samples_free, &p->samples[i]);
+	}
+
+	if (verify_is_enabled()) {
+		verifier = verify_start(NULL, 0);
+	}
+	es = encoder_stream_open(filepath, pipeline_total_samples(p), verifier);
+	md5_init(&md5);
+
+	if (pthread_create(&reader, NULL, pipeline_reader, p) != 0 || pthread_create(&renderer, NULL, pipeline_renderer, p) != 0) {
+		fprintf(stderr, "pthread_create failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* encoder stage; keeps draining after an error so the other stages can finish */
+	for (;;) {
+		s = (struct pipeline_samples *) ring_get(&p->samples_full);
+		if (s->len == 0) {
+			ring_put(&p->samples_free, s);
+			break;
+		}
+		if (verifier != NULL) {
+			md5_update_samples(&md5, s->data, s->len);
+		}
+		if (encoder_stream_write(es, s->data, s->len) == -1) {
+			rc = -1;
+		}
+		total += s->len;
+		ring_put(&p->samples_free, s);
+	}
+
+	pthread_join(reader, NULL);
+	pthread_join(renderer, NULL);
+
+	if (p->read_error) {
+		fprintf(stderr, "Could not read the input\n");
+		rc = -1;
+	}
+	if (encoder_stream_close(es, NULL) == -1) {
+		rc = -1;
+	}
+
+	stats->text_len = p->text_len;
+	stats->total_samples = total;
+	stats->verified = 0;
+	if (verifier != NULL) {
+		md5_final(&md5, digest);
+		stats->verified = verify_finish_digest(verifier, digest, total) == 0 ? 1 : -1;
+	}
+
+	ring_exit(&p->text_full);
+	ring_exit(&p->text_free);
+	ring_exit(&p->samples_full);
+	ring_exit(&p->samples_free);
+	free(p->whole);
+	free(p);
+
+	return rc;
+}
@@ -0,0 +1,41 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#ifndef TEXT_TO_MORSE_NO_PRESETS
+
+#include "presets.h"
+
+#include <stdlib.h>
+
+/* the build-time waveforms for `wpm` and `frequency`, or NULL if there aren't any */
+const struct preset *presets_find(int wpm, int frequency) {
+	size_t i;
+
+	for (i = 0; i < presets_len; i++) {
+		if (presets[i].wpm == wpm && presets[i].frequency == frequency) {
+			return &presets[i];
+		}
+	}
+
+	return NULL;
+}
+
+#endif
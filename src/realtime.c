@@ -0,0 +1,404 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Real-time output: raw 16-bit little-endian samples written at exactly
+ * the sample rate, for piping into a player or an SDR. A reader thread
+ * renders text as it arrives; the writer keeps `buffer_ms` of audio ahead
+ * of the wall clock and sends REALTIME_BLOCK samples every 20 ms, filling
+ * in silence while there is no text to send.
+ *
+ * The writer's clock starts when the first text has been rendered, so
+ * sample `o` plays at start + o / SAMPLE_RATE. A write that wakes up more
+ * than the buffer late has let the consumer run dry; that's an underrun,
+ * and the clock restarts from there.
+ *
+ * If the output fails, the writer sets `stop` and wakes the reader through
+ * a pipe it polls alongside the input, so the reader returns on its own
+ * instead of being cancelled while it holds the lock.
+ */
+
+#include "bytes.h"
+#include "encoder.h"
+#include "measure.h"
+#include "normalize.h"
+#include "realtime.h"
+#include "render.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* when the text that renders to queue position `sample` was read */
+struct realtime_mark {
+	size_t sample;
+	uint64_t read_ns;
+};
+
+struct realtime {
+	int fd;				/* input */
+	int wake[2];			/* written to when the writer stops */
+	struct measure m;
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready;		/* the reader added samples or finished */
+	pthread_cond_t room;		/* the writer took samples */
+	int16_t *queue;			/* rendered samples not yet written */
+	size_t head;
+	size_t len;
+	size_t cap;
+	size_t produced;		/* samples ever added to the queue */
+	struct realtime_mark marks[REALTIME_MARKS];
+	size_t nmarks;
+	size_t unmarked;		/* reads that found every mark in use */
+	int done;
+	int stop;			/* the writer gave up, stop reading */
+	int read_error;
+};
+
+static uint64_t realtime_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void realtime_sleep_until(uint64_t ns) {
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/* append `n` rendered samples to the queue, read from the input at `read_ns`; -1 once the writer has stopped */
+static int realtime_queue(struct realtime *rt, const int16_t *samples, size_t n, uint64_t read_ns) {
+	pthread_mutex_lock(&rt->lock);
+
+	/* a file can be read much faster than it plays, stay a few seconds ahead */
+	while (rt->len - rt->head > REALTIME_AHEAD && !rt->stop) {
+		pthread_cond_wait(&rt->room, &rt->lock);
+	}
+	if (rt->stop) {
+		pthread_mutex_unlock(&rt->lock);
+		return -1;
+	}
+
+	if (rt->head > 0 && rt->head >= rt->len / 2) {
+		memmove(rt->queue, rt->queue + rt->head, (rt->len - rt->head) * sizeof(int16_t));
+		rt->len -= rt->head;
+		rt->head = 0;
+	}
+	if (rt->len + n > rt->cap) {
+		int16_t *new_queue;
+
+		rt->cap = rt->len + n > 2 * rt->cap ? rt->len + n : 2 * rt->cap;
+		new_queue = (int16_t *) realloc(rt->queue, rt->cap * sizeof(int16_t));
+		if (new_queue == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+		rt->queue = new_queue;
+	}
+	memcpy(rt->queue + rt->len, samples, n * sizeof(int16_t));
+	rt->len += n;
+
+	if (rt->nmarks < REALTIME_MARKS) {
+		rt->marks[rt->nmarks].sample = rt->produced;
+		rt->marks[rt->nmarks].read_ns = read_ns;
+		rt->nmarks++;
+	} else {
+		rt->unmarked++;
+	}
+	rt->produced += n;
+
+	pthread_cond_signal(&rt->ready);
+	pthread_mutex_unlock(&rt->lock);
+
+	return 0;
+}
+
+/* read what's available from the input, -1 with errno ECANCELED once the writer has stopped */
+static ssize_t realtime_read(struct realtime *rt, unsigned char *text, size_t len) {
+	struct pollfd fds[2];
+
+	fds[0].fd = rt->fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = rt->wake[0];
+	fds[1].events = POLLIN;
+
+	if (poll(fds, 2, -1) == -1) {
+		return -1;
+	}
+	if (fds[1].revents != 0) {
+		errno = ECANCELED;
+		return -1;
+	}
+
+	return read(rt->fd, text, len);
+}
+
+/* read text as soon as it's written to the input and render it onto the queue */
+static void *realtime_reader(void *arg) {
+	struct realtime *rt = (struct realtime *) arg;
+	unsigned char text[REALTIME_TEXT + 1];
+	unsigned char *src;
+	struct normalize st;
+	int16_t *samples = NULL;
+	size_t cap = 0;
+	size_t first = 0;
+	size_t len;
+	size_t n;
+	ssize_t got;
+	uint64_t read_ns;
+
+	normalize_init(&st);
+	while ((got = realtime_read(rt, text + 1, REALTIME_TEXT)) != 0) {
+		if (got == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			rt->read_error = errno != ECANCELED;
+			break;
+		}
+		read_ns = realtime_now();
+
+		src = text + 1;
+		len = got;
+		if (normalize_is_enabled()) {
+			src = text;
+			len = normalize(&st, text, text + 1, len);
+		}
+		if (len == 0) {
+			continue;
+		}
+
+		n = measure_text(&rt->m, src, len, first);
+		if (n > cap) {
+			free(samples);
+			cap = n;
+			samples = (int16_t *) malloc(cap * sizeof(int16_t));
+			if (samples == NULL) {
+				fprintf(stderr, "malloc failed :(\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		render_span(samples, src, len, first);
+		first += len;
+
+		if (realtime_queue(rt, samples, n, read_ns) == -1) {
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&rt->lock);
+	rt->done = 1;
+	pthread_cond_signal(&rt->ready);
+	pthread_mutex_unlock(&rt->lock);
+
+	free(samples);
+
+	return NULL;
+}
+
+static int realtime_write(int fd, const int16_t *samples, size_t n) {
+	unsigned char bytes[REALTIME_BLOCK * 2];
+	size_t off = 0;
+	ssize_t wrote;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		bytes_put_le(bytes + 2 * i, (uint16_t) samples[i], 2);
+	}
+
+	while (off < n * 2) {
+		wrote = write(fd, bytes + off, n * 2 - off);
+		if (wrote == -1 && errno == EINTR) {
+			continue;
+		}
+		if (wrote == -1) {
+			return -1;
+		}
+		off += wrote;
+	}
+
+	return 0;
+}
+
+/*
+ * Stream `input` to `filepath` ("-" for stdout) in real time, keeping
+ * `buffer_ms` of audio ahead of the clock. Runs until the end of the
+ * input has been played out. Returns 0 on success, -1 on error.
+ */
+int realtime_run(FILE *input, char *filepath, int buffer_ms, struct realtime_stats *stats) {
+	struct realtime rt;
+	pthread_t reader;
+	int16_t block[REALTIME_BLOCK];
+	uint64_t lead = (uint64_t) buffer_ms * 1000000;	/* ns */
+	uint64_t start;
+	uint64_t deadline;
+	uint64_t now;
+	uint64_t played;
+	uint64_t latency;
+	size_t written = 0;
+	size_t consumed = 0;
+	size_t take;
+	size_t n;
+	size_t i;
+	size_t j;
+	int fd;
+	int finished = 0;
+	int rc = 0;
+
+	memset(stats, 0, sizeof(struct realtime_stats));
+	stats->latency_min = UINT64_MAX;
+
+	fd = strcmp(filepath, "-") == 0 ? STDOUT_FILENO : open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "Could not open output file '%s'\n", filepath);
+		return -1;
+	}
+
+	memset(&rt, 0, sizeof(struct realtime));
+	rt.fd = fileno(input);
+	if (pipe(rt.wake) == -1) {
+		fprintf(stderr, "Could not start the reader thread\n");
+		exit(EXIT_FAILURE);
+	}
+	render_measure(&rt.m);
+	pthread_mutex_init(&rt.lock, NULL);
+	pthread_cond_init(&rt.ready, NULL);
+	pthread_cond_init(&rt.room, NULL);
+
+	if (pthread_create(&reader, NULL, realtime_reader, &rt) != 0) {
+		fprintf(stderr, "Could not start the reader thread\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* no point sending silence before there's anything to say */
+	pthread_mutex_lock(&rt.lock);
+	while (rt.produced == 0 && !rt.done) {
+		pthread_cond_wait(&rt.ready, &rt.lock);
+	}
+	pthread_mutex_unlock(&rt.lock);
+
+	start = realtime_now();
+	while (!finished) {
+		/* sample `written` plays at start + written / SAMPLE_RATE, it's due `lead` before that */
+		deadline = start + (uint64_t) written * 1000000000 / SAMPLE_RATE;
+		deadline = deadline > start + lead ? deadline - lead : start;
+		now = realtime_now();
+		if (deadline > now) {
+			realtime_sleep_until(deadline);
+			now = realtime_now();
+			stats->jitter_sum += (now - deadline) / 1000;
+			stats->jitter_max = (now - deadline) / 1000 > stats->jitter_max ? (now - deadline) / 1000 : stats->jitter_max;
+			stats->jitter_count++;
+		}
+		if (written > 0 && now > deadline + lead) {
+			stats->underruns++;
+			start = now - (uint64_t) written * 1000000000 / SAMPLE_RATE;
+		}
+
+		pthread_mutex_lock(&rt.lock);
+		take = rt.len - rt.head < REALTIME_BLOCK ? rt.len - rt.head : REALTIME_BLOCK;
+		if (take > 0) {
+			memcpy(block, rt.queue + rt.head, take * sizeof(int16_t));
+		}
+		rt.head += take;
+		pthread_cond_signal(&rt.room);
+
+		/* text whose first sample goes out now: it plays once the samples ahead of it have */
+		for (i = 0, j = 0; i < rt.nmarks; i++) {
+			if (rt.marks[i].sample < consumed + take) {
+				played = start + (uint64_t) (written + rt.marks[i].sample - consumed) * 1000000000 / SAMPLE_RATE;
+				latency = played > rt.marks[i].read_ns ? (played - rt.marks[i].read_ns) / 1000 : 0;
+				stats->latency_min = latency < stats->latency_min ? latency : stats->latency_min;
+				stats->latency_max = latency > stats->latency_max ? latency : stats->latency_max;
+				stats->latency_sum += latency;
+				stats->latency_count++;
+			} else {
+				rt.marks[j++] = rt.marks[i];
+			}
+		}
+		rt.nmarks = j;
+		consumed += take;
+
+		finished = rt.done && rt.head == rt.len;
+		pthread_mutex_unlock(&rt.lock);
+
+		/* keep the stream going with silence until there's more text */
+		n = take;
+		if (!finished) {
+			memset(block + take, 0, (REALTIME_BLOCK - take) * sizeof(int16_t));
+			n = REALTIME_BLOCK;
+		}
+
+		if (n > 0 && realtime_write(fd, block, n) == -1) {
+			fprintf(stderr, "Could not write to '%s'\n", filepath);
+			rc = -1;
+			break;
+		}
+		written += n;
+	}
+
+	if (rc == -1) {
+		/* the reader may be blocked on input that never comes, or on a full queue */
+		pthread_mutex_lock(&rt.lock);
+		rt.stop = 1;
+		pthread_cond_signal(&rt.room);
+		pthread_mutex_unlock(&rt.lock);
+		while (write(rt.wake[1], "", 1) == -1 && errno == EINTR);
+	}
+	pthread_join(reader, NULL);
+
+	if (rt.read_error) {
+		fprintf(stderr, "Could not read the input\n");
+		rc = -1;
+	}
+
+	stats->samples = written;
+	stats->latency_unmeasured = rt.unmarked;
+	if (stats->latency_count == 0) {
+		stats->latency_min = 0;
+	}
+
+	pthread_mutex_destroy(&rt.lock);
+	pthread_cond_destroy(&rt.ready);
+	pthread_cond_destroy(&rt.room);
+	free(rt.queue);
+	close(rt.wake[0]);
+	close(rt.wake[1]);
+
+	if (fd != STDOUT_FILENO) {
+		close(fd);
+	}
+
+	return rc;
+}
@@ -18,16 +18,25 @@
     SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include "align.h"
+#include "kernels.h"
+#include "measure.h"
 #include "morse.h"
+#include "normalize.h"
+#include "probes.h"
 #include "render.h"
 #include "space.h"
 #include "tone.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 
+/* don't bother starting a thread for less than this many input bytes */
+#define RENDER_MIN_SLICE (4096)
+
 /* resulting waveform before encoding */
 static int16_t *result = NULL;
 static size_t result_len = 0;
@@ -39,21 +48,27 @@ size_t render_get_total_samples(void)	{ return total_samples; }
 
 /*
  * Append raw samples to the `result` buffer, growing it as needed.
+ * With `data` NULL, append `len` samples of silence.
  */
-static void render_buf_append(int16_t *data, size_t len) {
+static void render_buf_append(const int16_t *data, size_t len) {
 
 	int16_t *new_result = NULL;
 	size_t new_len = 0;
 
 	new_len = result_len + len;
 
+	PROBE2(buffer_grow, result_len, new_len);
 	new_result = (int16_t *) realloc(result, new_len * sizeof(int16_t));
 	if (new_result == NULL) {
 		fprintf(stderr, "malloc failed :(\n");
 		exit(EXIT_FAILURE);
 	}
 
-	memcpy(new_result + result_len, data, len * sizeof(int16_t));
+	if (data != NULL) {
+		kernels_get()->copy(new_result + result_len, data, len);
+	} else {
+		kernels_get()->zero(new_result + result_len, len);
+	}
 
 	result = new_result;
 	result_len += len;
@@ -65,9 +80,9 @@ static void render_buf_append(int16_t *data, size_t len) {
 /* write pre-rendered samples to the `result` buffer */
 static void render_dit(void) { render_buf_append(tone_get_dit(), tone_get_dit_len()); }
 static void render_dah(void) { render_buf_append(tone_get_dah(), tone_get_dah_len()); }
-static void render_inter_character_space(void) { render_buf_append(space_get_inter_character(), space_get_inter_character_len()); }
-static void render_intra_character_space(void) { render_buf_append(space_get_intra_character(), space_get_intra_character_len()); }
-static void render_inter_word_space(void) { render_buf_append(space_get_inter_word_space(), space_get_inter_word_len()); }
+static void render_inter_character_space(void) { render_buf_append(NULL, space_get_inter_character_len()); }
+static void render_intra_character_space(void) { render_buf_append(NULL, space_get_intra_character_len()); }
+static void render_inter_word_space(void) { render_buf_append(NULL, space_get_inter_word_len()); }
 
 /* build a character out of dits, dahs, and/or spaces */
 static void render_character(unsigned char c) {
@@ -94,15 +109,252 @@ static void render_character(unsigned char c) {
 }
 
 void render_text(FILE *input) {
+	size_t start;
 	int i;
-	char ch;
+	int ch;
 
 	for (i = 0; (ch = getc(input)) != EOF; i++) {
 		if (i != 0) {
 			render_inter_character_space();
 		}
+		if (align_is_enabled()) {
+			align_char(ch, i, result_len);
+		}
+		start = result_len;
 		render_character(ch);
+		PROBE3(character, ch, i, result_len - start);
+	}
+}
+
+/* copy `len` samples of an element to `dst`, returning the end of the copy */
+static int16_t *render_copy(int16_t *dst, const int16_t *src, size_t len) {
+	kernels_get()->copy(dst, src, len);
+	return dst + len;
+}
+
+/* `len` samples of silence; spaces are always silent, so they are filled rather than copied */
+static int16_t *render_silence(int16_t *dst, size_t len) {
+	kernels_get()->zero(dst, len);
+	return dst + len;
+}
+
+/* the elements set up by tone_init() and space_init(), valid until tone_exit() and space_exit() */
+void render_elements(struct elements *e) {
+	e->dit = tone_get_dit();				e->dit_len = tone_get_dit_len();
+	e->dah = tone_get_dah();				e->dah_len = tone_get_dah_len();
+	e->intra_character = space_get_intra_character();	e->intra_character_len = space_get_intra_character_len();
+	e->inter_character = space_get_inter_character();	e->inter_character_len = space_get_inter_character_len();
+	e->inter_word = space_get_inter_word_space();		e->inter_word_len = space_get_inter_word_len();
+}
+
+/* render_span() with the elements in `e`; safe to run for different element sets at once */
+void render_span_elements(const struct elements *e, int16_t *dst, const unsigned char *text, size_t len, size_t first) {
+	size_t i;
+	int j;
+
+	for (i = 0; i < len; i++) {
+		const char *s = morse_alphabet[text[i]];
+		int16_t *start;
+
+		if (first + i != 0) {
+			dst = render_silence(dst, e->inter_character_len);
+		}
+		start = dst;
+		for (j = 0; s[j] != '\0'; j++) {
+			if (j != 0) {
+				dst = render_silence(dst, e->intra_character_len);
+			}
+			switch (s[j]) {
+				case ' ':
+					dst = render_silence(dst, e->inter_word_len);
+					break;
+				case '.':
+					dst = render_copy(dst, e->dit, e->dit_len);
+					break;
+				case '-':
+					dst = render_copy(dst, e->dah, e->dah_len);
+					break;
+			}
+		}
+		PROBE3(character, text[i], first + i, dst - start);
+	}
+}
+
+/*
+ * Render `len` bytes of `text` straight into `dst`, which must have room
+ * for measure_text() samples. `first` is the position of text[0] in the
+ * whole input. Same output as render_text() for the same bytes.
+ */
+void render_span(int16_t *dst, const unsigned char *text, size_t len, size_t first) {
+	struct elements e;
+
+	render_elements(&e);
+	render_span_elements(&e, dst, text, len, first);
+}
+
+/* one thread's share of the input in render_text_parallel() */
+struct render_slice {
+	const struct measure *m;
+	const unsigned char *text;
+	size_t len;
+	size_t first;		/* position of text[0] in the input */
+	size_t offset;		/* position of the first sample in `result` */
+	size_t nsamples;
+};
+
+static void *render_slice_measure(void *arg) {
+	struct render_slice *slice = (struct render_slice *) arg;
+
+	slice->nsamples = measure_text(slice->m, slice->text, slice->len, slice->first);
+
+	return NULL;
+}
+
+static void *render_slice_fill(void *arg) {
+	struct render_slice *slice = (struct render_slice *) arg;
+
+	render_span(result + slice->offset, slice->text, slice->len, slice->first);
+
+	return NULL;
+}
+
+/* run `fn` on every slice, one thread each (the caller takes the first) */
+static void render_slices_run(struct render_slice *slices, int nslices, void *(*fn)(void *)) {
+	pthread_t *threads;
+	int i;
+
+	threads = (pthread_t *) malloc(nslices * sizeof(pthread_t));
+	if (threads == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 1; i < nslices; i++) {
+		if (pthread_create(&threads[i], NULL, fn, &slices[i]) != 0) {
+			fprintf(stderr, "pthread_create failed :(\n");
+			exit(EXIT_FAILURE);
+		}
 	}
+	fn(&slices[0]);
+	for (i = 1; i < nslices; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	free(threads);
+}
+
+/* read all of `input` into memory */
+unsigned char *render_read(FILE *input, size_t *len) {
+	unsigned char *text = NULL;
+	unsigned char *new_text;
+	size_t cap = 0;
+	size_t n;
+
+	*len = 0;
+	do {
+		if (*len == cap) {
+			cap = cap == 0 ? 64 * 1024 : cap * 2;
+			new_text = (unsigned char *) realloc(text, cap);
+			if (new_text == NULL) {
+				fprintf(stderr, "malloc failed :(\n");
+				exit(EXIT_FAILURE);
+			}
+			text = new_text;
+		}
+		n = fread(text + *len, 1, cap - *len, input);
+		*len += n;
+	} while (n > 0);
+
+	if (normalize_is_enabled()) {
+		struct normalize st;
+
+		normalize_init(&st);
+		*len = normalize(&st, text, text, *len);
+	}
+
+	return text;
+}
+
+/* character lengths for the current dit, dah and space elements */
+void render_measure(struct measure *m) {
+	measure_init(m, tone_get_dit_len(), tone_get_dah_len(), space_get_intra_character_len(), space_get_inter_character_len(), space_get_inter_word_len());
+}
+
+/*
+ * Render `len` bytes of `text` into the result buffer, spread over `jobs`
+ * threads. Same output as render_text(). Every character's length only
+ * depends on the character, so each thread first measures its slice of
+ * the input, a prefix sum over the slices gives each one its offset in a
+ * single preallocated buffer, and then every thread renders its slice
+ * straight into place.
+ */
+void render_buffer(const unsigned char *text, size_t len, int jobs) {
+	struct measure m;
+	struct render_slice *slices;
+	size_t per;
+	size_t offset;
+	size_t pos;
+	int nslices;
+	int i;
+
+	render_measure(&m);
+
+	jobs = jobs < 1 ? 1 : jobs;
+	nslices = len / RENDER_MIN_SLICE + 1;
+	nslices = nslices < jobs ? nslices : jobs;
+	per = (len + nslices - 1) / nslices;
+
+	slices = (struct render_slice *) calloc(nslices, sizeof(struct render_slice));
+	if (slices == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < nslices; i++) {
+		slices[i].m = &m;
+		slices[i].first = per * i < len ? per * i : len;
+		slices[i].text = text + slices[i].first;
+		slices[i].len = len - slices[i].first < per ? len - slices[i].first : per;
+	}
+
+	render_slices_run(slices, nslices, render_slice_measure);
+
+	offset = 0;
+	for (i = 0; i < nslices; i++) {
+		slices[i].offset = offset;
+		offset += slices[i].nsamples;
+	}
+
+	render_exit();
+	result = (int16_t *) malloc((offset > 0 ? offset : 1) * sizeof(int16_t));
+	if (result == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	result_len = total_samples = offset;
+
+	render_slices_run(slices, nslices, render_slice_fill);
+
+	if (align_is_enabled()) {
+		offset = 0;
+		for (pos = 0; pos < len; pos++) {
+			offset += pos != 0 ? m.inter_character : 0;
+			align_char(text[pos], pos, offset);
+			offset += m.character[text[pos]];
+		}
+	}
+
+	free(slices);
+}
+
+/* read all of `input` and render it with render_buffer() */
+void render_text_parallel(FILE *input, int jobs) {
+	unsigned char *text;
+	size_t len;
+
+	text = render_read(input, &len);
+	render_buffer(text, len, jobs);
+	free(text);
 }
 
 void render_exit(void) {
@@ -0,0 +1,103 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Beacons: the same message over and over with a fixed gap. One
+ * repetition (the message and the gap after it) is rendered and encoded
+ * once, starting and ending on frame boundaries. The file is then written
+ * by copying those frames once per repetition with their headers
+ * renumbered, so a day of beacon costs about as much as one message.
+ *
+ * STREAMINFO's MD5 is left zero ("not computed"): hashing every
+ * repetition would cost more than writing them. Instead the repetition is
+ * verified once, by decoding its frames, before any copies are made.
+ */
+
+#include "encoder.h"
+#include "frames.h"
+#include "repeat.h"
+#include "verify.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Write `count` repetitions of `samples` followed by `gap` samples of
+ * silence to `filepath`. `verified` is set like for a single output.
+ * Returns 0 on success, -1 on error.
+ */
+int repeat_encode(char *filepath, const int16_t *samples, size_t nsamples, size_t gap, size_t count, int seek_interval, int *verified) {
+	struct frame_list l;
+	struct flacstream *fs;
+	int16_t *unit;
+	size_t len = nsamples + gap;
+	size_t r;
+	size_t i;
+	int rc = 0;
+
+	*verified = 0;
+
+	unit = (int16_t *) calloc(len > 0 ? len : 1, sizeof(int16_t));
+	if (unit == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(unit, samples, nsamples * sizeof(int16_t));
+
+	memset(&l, 0, sizeof(struct frame_list));
+	if (encoder_encode_frames(unit, len, &l) == -1) {
+		fprintf(stderr, "ERROR: encoding\n");
+		frames_free(&l);
+		free(unit);
+		return -1;
+	}
+
+	if (verify_is_enabled()) {
+		*verified = verify_frames(unit, len, &l) == 0 ? 1 : -1;
+	}
+	free(unit);
+
+	fs = flacstream_open(filepath, (uint64_t) len * count, seek_interval, NULL, NULL, 0);
+	if (fs == NULL) {
+		fprintf(stderr, "ERROR: could not open output file '%s'\n", filepath);
+		frames_free(&l);
+		return -1;
+	}
+
+	for (r = 0; r < count && rc == 0; r++) {
+		for (i = 0; i < l.len && rc == 0; i++) {
+			rc = flacstream_frame(fs, l.data + l.frames[i].offset, l.frames[i].bytes, l.frames[i].samples);
+		}
+	}
+
+	if (flacstream_close(fs, NULL, NULL) == -1) {
+		rc = -1;
+	}
+	if (rc == -1) {
+		fprintf(stderr, "ERROR: writing output file '%s'\n", filepath);
+	}
+
+	frames_free(&l);
+
+	return rc;
+}
@@ -0,0 +1,144 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include "ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* `size` is rounded up to a power of two so indexes wrap with a mask */
+int ring_init(struct ring *r, size_t size) {
+	size_t n = 1;
+
+	while (n < size) {
+		n <<= 1;
+	}
+
+	r->slots = (void **) calloc(n, sizeof(void *));
+	if (r->slots == NULL) {
+		return -1;
+	}
+	r->mask = n - 1;
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->waiting, 0);
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->wake, NULL);
+
+	return 0;
+}
+
+/*
+ * Sleep until the ring has an item (`items`) or a free slot. The waiter
+ * announces itself before it looks at the indexes again and the other
+ * side moves its index before it looks for waiters, so one of the two
+ * always sees the other.
+ */
+static void ring_wait(struct ring *r, int items) {
+	pthread_mutex_lock(&r->lock);
+	atomic_fetch_add(&r->waiting, 1);
+	while (items ? atomic_load(&r->head) == atomic_load(&r->tail) : atomic_load(&r->tail) - atomic_load(&r->head) > r->mask) {
+		pthread_cond_wait(&r->wake, &r->lock);
+	}
+	atomic_fetch_sub(&r->waiting, 1);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/* after a put or a get: wake the other side if it's asleep */
+static void ring_wake(struct ring *r) {
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&r->waiting, memory_order_relaxed) > 0) {
+		pthread_mutex_lock(&r->lock);
+		pthread_cond_broadcast(&r->wake);
+		pthread_mutex_unlock(&r->lock);
+	}
+}
+
+/* producer side: returns -1 when the ring is full */
+int ring_try_put(struct ring *r, void *p) {
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+	if (tail - head > r->mask) {
+		return -1;
+	}
+
+	r->slots[tail & r->mask] = p;
+	atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+	ring_wake(r);
+
+	return 0;
+}
+
+/* consumer side: returns NULL when the ring is empty */
+void *ring_try_get(struct ring *r) {
+	size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+	void *p;
+
+	if (head == tail) {
+		return NULL;
+	}
+
+	p = r->slots[head & r->mask];
+	atomic_store_explicit(&r->head, head + 1, memory_order_release);
+	ring_wake(r);
+
+	return p;
+}
+
+/* wait for a free slot; a full ring holds the producer back */
+void ring_put(struct ring *r, void *p) {
+	int spins = 0;
+
+	while (ring_try_put(r, p) == -1) {
+		if (spins++ < RING_SPINS) {
+			sched_yield();
+		} else {
+			ring_wait(r, 0);
+		}
+	}
+}
+
+/* wait for an item */
+void *ring_get(struct ring *r) {
+	int spins = 0;
+	void *p;
+
+	while ((p = ring_try_get(r)) == NULL) {
+		if (spins++ < RING_SPINS) {
+			sched_yield();
+		} else {
+			ring_wait(r, 1);
+		}
+	}
+
+	return p;
+}
+
+void ring_exit(struct ring *r) {
+	free(r->slots);
+	r->slots = NULL;
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->wake);
+}
@@ -0,0 +1,249 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Splits the output into files of about the same duration. Cuts fall on
+ * the first sample of a character, preferably the first character of a
+ * word, as close as possible to the target length. The segments are
+ * slices of one render: played back to back they are the whole output.
+ * They are encoded on a pool of worker threads.
+ */
+
+#include "encoder.h"
+#include "measure.h"
+#include "output.h"
+#include "segment.h"
+#include "verify.h"
+#include "work.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* what the encoding threads share */
+struct segment_pool {
+	const int16_t *samples;
+	struct segment *segments;
+};
+
+static int segment_word_start(const unsigned char *text, size_t i) {
+	return i > 0 && isspace(text[i - 1]) && !isspace(text[i]);
+}
+
+/* distance between two sample offsets */
+static size_t segment_distance(size_t a, size_t b) {
+	return a > b ? a - b : b - a;
+}
+
+/* "book.flac" -> "book-001.flac", or "book.segments" when `n` is 0 */
+static char *segment_name(const char *filepath, size_t n) {
+	char suffix[32];
+
+	if (n == 0) {
+		return output_name(filepath, "", ".segments");
+	}
+	sprintf(suffix, "-%03zu", n);
+
+	return output_name(filepath, suffix, NULL);
+}
+
+/*
+ * Work out where to cut `text` into segments of about `target` samples.
+ * Filenames are filled in by segment_encode().
+ */
+struct segment *segment_plan(const unsigned char *text, size_t len, const struct measure *m, size_t target, size_t *nsegments) {
+	struct segment *segments = NULL;
+	size_t *offset;			/* first sample of each character's own audio */
+	size_t window = target * SEGMENT_WORD_WINDOW;
+	size_t total = 0;
+	size_t cap = 0;
+	size_t start = 0;
+	size_t i;
+
+	offset = (size_t *) malloc((len + 1) * sizeof(size_t));
+	if (offset == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < len; i++) {
+		total += i != 0 ? m->inter_character : 0;
+		offset[i] = total;
+		total += m->character[text[i]];
+	}
+	offset[len] = total;
+
+	*nsegments = 0;
+	do {
+		size_t ideal = offset[start] + target;
+		size_t lo = start + 1;
+		size_t hi = len;
+		size_t cut = len;
+		size_t k;
+
+		if (total > ideal && start < len) {
+			/* first character starting at or after the ideal cut */
+			while (lo < hi) {
+				size_t mid = lo + (hi - lo) / 2;
+
+				if (offset[mid] < ideal) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			cut = lo;
+			if (cut > start + 1 && segment_distance(offset[cut - 1], ideal) < segment_distance(offset[cut], ideal)) {
+				cut--;
+			}
+
+			/* nearest word start within the window, looking both ways */
+			for (k = 0; ; k++) {
+				int more = 0;
+
+				if (cut >= k + start + 1 && segment_distance(offset[cut - k], ideal) <= window) {
+					more = 1;
+					if (segment_word_start(text, cut - k)) {
+						cut -= k;
+						break;
+					}
+				}
+				if (cut + k < len && segment_distance(offset[cut + k], ideal) <= window) {
+					more = 1;
+					if (segment_word_start(text, cut + k)) {
+						cut += k;
+						break;
+					}
+				}
+				if (!more) {
+					break;
+				}
+			}
+		}
+
+		if (*nsegments == cap) {
+			struct segment *new_segments;
+
+			cap = cap == 0 ? 16 : cap * 2;
+			new_segments = (struct segment *) realloc(segments, cap * sizeof(struct segment));
+			if (new_segments == NULL) {
+				fprintf(stderr, "malloc failed :(\n");
+				exit(EXIT_FAILURE);
+			}
+			segments = new_segments;
+		}
+
+		memset(&segments[*nsegments], 0, sizeof(struct segment));
+		segments[*nsegments].first_byte = start;
+		segments[*nsegments].bytes = cut - start;
+		segments[*nsegments].first_sample = offset[start];
+		segments[*nsegments].samples = (cut == len ? total : offset[cut]) - segments[*nsegments].first_sample;
+		(*nsegments)++;
+
+		start = cut;
+	} while (start < len);
+
+	free(offset);
+
+	return segments;
+}
+
+static int segment_worker(void *arg, size_t i) {
+	struct segment_pool *pool = (struct segment_pool *) arg;
+	struct segment *s = &pool->segments[i];
+	struct verify *verifier;
+
+	verifier = verify_is_enabled() ? verify_start(pool->samples + s->first_sample, s->samples) : NULL;
+	s->rc = encoder_encode(s->filepath, pool->samples + s->first_sample, s->samples, s->samples, verifier, NULL);
+	if (verifier != NULL) {
+		s->verified = verify_finish(verifier) == 0 ? 1 : -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Encode every segment of `samples` to its own numbered file next to
+ * `filepath`, on `jobs` threads. `verified` is set like for a single
+ * output: 1 all passed, -1 any failed, 0 not verified.
+ */
+int segment_encode(char *filepath, const int16_t *samples, struct segment *segments, size_t nsegments, int jobs, int *verified) {
+	struct segment_pool pool;
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < nsegments; i++) {
+		segments[i].filepath = segment_name(filepath, i + 1);
+	}
+
+	pool.samples = samples;
+	pool.segments = segments;
+	work_run(nsegments, jobs, segment_worker, &pool);
+
+	*verified = 0;
+	for (i = 0; i < nsegments; i++) {
+		if (segments[i].rc != 0) {
+			fprintf(stderr, "Could not write output file '%s'\n", segments[i].filepath);
+			rc = -1;
+		}
+		if (segments[i].verified == -1 || (segments[i].verified == 1 && *verified == 0)) {
+			*verified = segments[i].verified;
+		}
+	}
+
+	return rc;
+}
+
+/*
+ * List the segments of `filepath` in "book.segments" next to them, tab
+ * separated: file, first byte, bytes, first sample, samples, seconds.
+ */
+int segment_write_manifest(char *filepath, struct segment *segments, size_t nsegments) {
+	FILE *out;
+	char *name;
+	size_t i;
+
+	name = segment_name(filepath, 0);
+	out = fopen(name, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Could not open segment manifest '%s'\n", name);
+		free(name);
+		return -1;
+	}
+	free(name);
+
+	for (i = 0; i < nsegments; i++) {
+		fprintf(out, "%s\t%zu\t%zu\t%zu\t%zu\t%.3f\n", segments[i].filepath, segments[i].first_byte, segments[i].bytes,
+			segments[i].first_sample, segments[i].samples, (double) segments[i].samples / SAMPLE_RATE);
+	}
+
+	return fclose(out) == 0 ? 0 : -1;
+}
+
+void segment_free(struct segment *segments, size_t nsegments) {
+	size_t i;
+
+	for (i = 0; i < nsegments; i++) {
+		free(segments[i].filepath);
+	}
+	free(segments);
+}
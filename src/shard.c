@@ -0,0 +1,462 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Shards: many short clips packed into a few large files instead of one
+ * tiny FLAC file each. Every line of the input is a clip. The clips are
+ * rendered and encoded on a pool of workers and appended, in line order,
+ * to clips-000000.shard, clips-000001.shard, ... as bare FLAC frames (no
+ * per-clip header); a shard is closed once the next clip would take it
+ * over its size. The index, clips.idx, says where each clip went:
+ *
+ *   header (32 bytes, little-endian)
+ *     "TTMSHARD", version u32, record size u32, clips u64, sample rate u32, shards u32
+ *   one record per clip (40 bytes)
+ *     byte offset in the shard u64, samples u64, text offset u64,
+ *     bytes u32, text length u32, shard u32, tone u16, wpm u8, fwpm u8
+ *   the text of every clip, back to back
+ *
+ * Records are fixed size, so finding clip N is one seek, and reading it
+ * is one more. shard_extract() puts a STREAMINFO back in front of the
+ * frames to make a regular FLAC file of it.
+ */
+
+#include "bytes.h"
+#include "encoder.h"
+#include "frames.h"
+#include "measure.h"
+#include "output.h"
+#include "render.h"
+#include "shard.h"
+#include "verify.h"
+#include "work.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* a line of the input */
+struct shard_line {
+	size_t start;
+	size_t len;
+};
+
+struct shard_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t turn;
+	size_t written;		/* clips appended so far; only the worker holding clip `written` writes */
+
+	const unsigned char *text;
+	struct shard_line *lines;
+	size_t nlines;
+	struct elements e;
+	struct measure m;
+	int wpm;
+	int fwpm;
+	int frequency;
+
+	char *filepath;
+	uint64_t shard_size;
+	FILE *out;		/* current shard */
+	char *out_name;
+	uint64_t out_len;
+	uint32_t shard;		/* number of the current shard */
+	size_t nshards;
+
+	struct shard_clip *clips;
+	int rc;
+	int verified;
+};
+
+/* clips.idx -> clips-000042.shard */
+static char *shard_name(const char *filepath, uint32_t shard) {
+	char suffix[32];
+
+	sprintf(suffix, "-%06u", (unsigned) shard);
+
+	return output_name(filepath, suffix, ".shard");
+}
+
+/* split `text` into lines, dropping the line breaks ("\n" or "\r\n") */
+static struct shard_line *shard_lines(const unsigned char *text, size_t len, size_t *nlines) {
+	struct shard_line *lines;
+	size_t n = 0;
+	size_t start = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		n += text[i] == '\n';
+	}
+	n += len > 0 && text[len - 1] != '\n';
+
+	lines = (struct shard_line *) malloc((n > 0 ? n : 1) * sizeof(struct shard_line));
+	if (lines == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	*nlines = 0;
+	for (i = 0; i <= len; i++) {
+		if (i == len ? i > start : text[i] == '\n') {
+			lines[*nlines].start = start;
+			lines[*nlines].len = i - start - (i > start && text[i - 1] == '\r');
+			(*nlines)++;
+			start = i + 1;
+		}
+	}
+
+	return lines;
+}
+
+/* append clip `i`'s frames to the current shard, starting the next one if it would grow past the limit */
+static int shard_append(struct shard_pool *pool, size_t i, struct frame_list *l) {
+	struct shard_clip *c = &pool->clips[i];
+	uint64_t bytes = 0;
+	size_t j;
+
+	for (j = 0; j < l->len; j++) {
+		bytes += l->frames[j].bytes;
+	}
+	if (bytes > UINT32_MAX) {
+		fprintf(stderr, "Clip %zu is too large for a shard\n", i);
+		return -1;
+	}
+
+	if (pool->out != NULL && pool->out_len > 0 && pool->out_len + bytes > pool->shard_size) {
+		if (fclose(pool->out) != 0) {
+			pool->out = NULL;
+			fprintf(stderr, "Could not write output file '%s'\n", pool->out_name);
+			return -1;
+		}
+		pool->out = NULL;
+		free(pool->out_name);
+		pool->out_name = NULL;
+		pool->shard++;
+	}
+
+	if (pool->out == NULL && bytes > 0) {
+		pool->out_name = shard_name(pool->filepath, pool->shard);
+		pool->out = fopen(pool->out_name, "wb");
+		if (pool->out == NULL) {
+			fprintf(stderr, "Could not open output file '%s'\n", pool->out_name);
+			return -1;
+		}
+		pool->out_len = 0;
+		pool->nshards++;
+	}
+
+	c->shard = pool->shard;
+	c->offset = pool->out_len;
+	c->bytes = (uint32_t) bytes;
+
+	for (j = 0; j < l->len; j++) {
+		if (fwrite(l->data + l->frames[j].offset, 1, l->frames[j].bytes, pool->out) != l->frames[j].bytes) {
+			fprintf(stderr, "Could not write output file '%s'\n", pool->out_name);
+			return -1;
+		}
+	}
+	pool->out_len += bytes;
+
+	return 0;
+}
+
+/* render, encode and append clip `i`; -1 once any clip failed, so no more are started */
+static int shard_worker(void *arg, size_t i) {
+	struct shard_pool *pool = (struct shard_pool *) arg;
+	struct shard_line *line;
+	struct shard_clip *c;
+	struct frame_list l;
+	int16_t *samples;
+	int verified = 0;
+	int rc;
+
+	line = &pool->lines[i];
+	c = &pool->clips[i];
+	c->samples = measure_text(&pool->m, pool->text + line->start, line->len, 0);
+	c->text_offset = line->start;
+	c->text_len = line->len;
+	c->wpm = pool->wpm;
+	c->fwpm = pool->fwpm;
+	c->frequency = pool->frequency;
+
+	samples = (int16_t *) malloc((c->samples > 0 ? c->samples : 1) * sizeof(int16_t));
+	if (samples == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	render_span_elements(&pool->e, samples, pool->text + line->start, line->len, 0);
+
+	memset(&l, 0, sizeof(struct frame_list));
+	rc = c->samples > 0 ? encoder_encode_frames(samples, c->samples, &l) : 0;
+	if (rc == -1) {
+		fprintf(stderr, "ERROR: encoding clip %zu\n", i);
+	}
+	if (rc == 0 && c->samples > 0 && verify_is_enabled()) {
+		verified = verify_frames(samples, c->samples, &l) == 0 ? 1 : -1;
+	}
+	free(samples);
+
+	/* wait for the clips before this one, so shards are written front to back */
+	pthread_mutex_lock(&pool->lock);
+	while (pool->written != i) {
+		pthread_cond_wait(&pool->turn, &pool->lock);
+	}
+	rc = rc == 0 && pool->rc == 0 ? 0 : -1;
+	pthread_mutex_unlock(&pool->lock);
+
+	if (rc == 0) {
+		rc = shard_append(pool, i, &l);
+	}
+	frames_free(&l);
+
+	pthread_mutex_lock(&pool->lock);
+	if (rc == -1) {
+		pool->rc = -1;
+	}
+	if (verified == -1 || (verified == 1 && pool->verified == 0)) {
+		pool->verified = verified;
+	}
+	pool->written++;
+	pthread_cond_broadcast(&pool->turn);
+	rc = pool->rc;
+	pthread_mutex_unlock(&pool->lock);
+
+	return rc;
+}
+
+static int shard_write_index(char *filepath, const unsigned char *text, const struct shard_clip *clips, size_t nclips, size_t nshards) {
+	unsigned char rec[SHARD_RECORD_SIZE];
+	uint64_t text_offset = 0;
+	FILE *out;
+	size_t i;
+	int ok = 1;
+
+	out = fopen(filepath, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Could not open output file '%s'\n", filepath);
+		return -1;
+	}
+
+	memset(rec, 0, sizeof(rec));
+	memcpy(rec, SHARD_MAGIC, 8);
+	bytes_put_le(rec + 8, SHARD_VERSION, 4);
+	bytes_put_le(rec + 12, SHARD_RECORD_SIZE, 4);
+	bytes_put_le(rec + 16, nclips, 8);
+	bytes_put_le(rec + 24, SAMPLE_RATE, 4);
+	bytes_put_le(rec + 28, nshards, 4);
+	ok &= fwrite(rec, 1, SHARD_HEADER_SIZE, out) == SHARD_HEADER_SIZE;
+
+	/* the text is stored back to back, without the line breaks */
+	for (i = 0; ok && i < nclips; i++) {
+		bytes_put_le(rec, clips[i].offset, 8);
+		bytes_put_le(rec + 8, clips[i].samples, 8);
+		bytes_put_le(rec + 16, text_offset, 8);
+		bytes_put_le(rec + 24, clips[i].bytes, 4);
+		bytes_put_le(rec + 28, clips[i].text_len, 4);
+		bytes_put_le(rec + 32, clips[i].shard, 4);
+		bytes_put_le(rec + 36, clips[i].frequency, 2);
+		rec[38] = clips[i].wpm;
+		rec[39] = clips[i].fwpm;
+		ok &= fwrite(rec, 1, SHARD_RECORD_SIZE, out) == SHARD_RECORD_SIZE;
+		text_offset += clips[i].text_len;
+	}
+
+	for (i = 0; ok && i < nclips; i++) {
+		ok &= fwrite(text + clips[i].text_offset, 1, clips[i].text_len, out) == clips[i].text_len;
+	}
+
+	ok &= fclose(out) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write output file '%s'\n", filepath);
+	}
+
+	return ok ? 0 : -1;
+}
+
+/*
+ * Render every line of `text` as its own clip, with the current tone and
+ * space settings, into shards of at most `shard_size` bytes (a clip
+ * larger than that gets a shard of its own) next to the index `filepath`,
+ * on `jobs` threads. Returns 0 on success, -1 on error.
+ */
+int shard_pack(const unsigned char *text, size_t len, char *filepath, uint64_t shard_size, int wpm, int fwpm, int frequency, int jobs, struct shard_stats *stats) {
+	struct shard_pool pool;
+
+	memset(&pool, 0, sizeof(struct shard_pool));
+	pool.text = text;
+	pool.lines = shard_lines(text, len, &pool.nlines);
+	render_elements(&pool.e);
+	render_measure(&pool.m);
+	pool.wpm = wpm;
+	pool.fwpm = fwpm;
+	pool.frequency = frequency;
+	pool.filepath = filepath;
+	pool.shard_size = shard_size;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.turn, NULL);
+
+	pool.clips = (struct shard_clip *) calloc(pool.nlines > 0 ? pool.nlines : 1, sizeof(struct shard_clip));
+	if (pool.clips == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	work_run(pool.nlines, jobs, shard_worker, &pool);
+	pthread_cond_destroy(&pool.turn);
+	pthread_mutex_destroy(&pool.lock);
+
+	if (pool.out != NULL && fclose(pool.out) != 0) {
+		fprintf(stderr, "Could not write output file '%s'\n", pool.out_name);
+		pool.rc = -1;
+	}
+	free(pool.out_name);
+
+	if (pool.rc == 0) {
+		pool.rc = shard_write_index(filepath, text, pool.clips, pool.nlines, pool.nshards);
+	}
+
+	stats->clips = pool.nlines;
+	stats->shards = pool.nshards;
+	stats->verified = pool.verified;
+
+	free(pool.clips);
+	free(pool.lines);
+
+	return pool.rc;
+}
+
+/*
+ * Write clip number `clip` of the shards indexed by `filepath` to
+ * `output` as a FLAC file. With `verbose` the clip's text and settings
+ * are printed. Returns 0 on success, -1 on error.
+ */
+int shard_extract(char *filepath, uint64_t clip, char *output, int seek_interval, int verbose) {
+	unsigned char hdr[SHARD_HEADER_SIZE];
+	unsigned char rec[SHARD_RECORD_SIZE];
+	struct shard_clip c;
+	struct flacstream *fs;
+	struct frame_list l;
+	unsigned char *data;
+	char *name;
+	uint64_t nclips;
+	FILE *in;
+	size_t i;
+	int rc = 0;
+
+	in = fopen(filepath, "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Could not open input file '%s'\n", filepath);
+		return -1;
+	}
+
+	if (fread(hdr, 1, SHARD_HEADER_SIZE, in) != SHARD_HEADER_SIZE || memcmp(hdr, SHARD_MAGIC, 8) != 0 || bytes_get_le(hdr + 8, 4) != SHARD_VERSION
+			|| bytes_get_le(hdr + 12, 4) != SHARD_RECORD_SIZE || bytes_get_le(hdr + 24, 4) != SAMPLE_RATE) {
+		fprintf(stderr, "'%s' is not a shard index\n", filepath);
+		fclose(in);
+		return -1;
+	}
+	nclips = bytes_get_le(hdr + 16, 8);
+	if (clip >= nclips) {
+		fprintf(stderr, "'%s' has %llu clips, there is no clip %llu\n", filepath, (unsigned long long) nclips, (unsigned long long) clip);
+		fclose(in);
+		return -1;
+	}
+
+	/* records are fixed size: one seek to find the clip */
+	if (fseeko(in, SHARD_HEADER_SIZE + clip * SHARD_RECORD_SIZE, SEEK_SET) != 0 || fread(rec, 1, SHARD_RECORD_SIZE, in) != SHARD_RECORD_SIZE) {
+		fprintf(stderr, "'%s' is damaged or incomplete\n", filepath);
+		fclose(in);
+		return -1;
+	}
+	c.offset = bytes_get_le(rec, 8);
+	c.samples = bytes_get_le(rec + 8, 8);
+	c.text_offset = bytes_get_le(rec + 16, 8);
+	c.bytes = bytes_get_le(rec + 24, 4);
+	c.text_len = bytes_get_le(rec + 28, 4);
+	c.shard = bytes_get_le(rec + 32, 4);
+	c.frequency = bytes_get_le(rec + 36, 2);
+	c.wpm = rec[38];
+	c.fwpm = rec[39];
+
+	if (verbose > 0) {
+		data = (unsigned char *) malloc(c.text_len + 1);
+		if (data == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+		if (fseeko(in, SHARD_HEADER_SIZE + nclips * SHARD_RECORD_SIZE + c.text_offset, SEEK_SET) == 0 && fread(data, 1, c.text_len, in) == c.text_len) {
+			fprintf(stdout, "Text: %.*s\n", (int) c.text_len, data);
+		}
+		fprintf(stdout, "Speed: %d/%d wpm\n", c.wpm, c.fwpm);
+		fprintf(stdout, "Tone: %d Hz\n", c.frequency);
+		fprintf(stdout, "Samples: %llu\n", (unsigned long long) c.samples);
+		free(data);
+	}
+	fclose(in);
+
+	data = (unsigned char *) malloc(c.bytes > 0 ? c.bytes : 1);
+	if (data == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* and one more to read it */
+	if (c.bytes > 0) {
+		name = shard_name(filepath, c.shard);
+		in = fopen(name, "rb");
+		if (in == NULL || fseeko(in, c.offset, SEEK_SET) != 0 || fread(data, 1, c.bytes, in) != c.bytes) {
+			fprintf(stderr, "Could not read clip %llu from '%s'\n", (unsigned long long) clip, name);
+			rc = -1;
+		}
+		if (in != NULL) {
+			fclose(in);
+		}
+		free(name);
+	}
+
+	memset(&l, 0, sizeof(struct frame_list));
+	if (rc == 0 && (frames_scan(data, c.bytes, &l) == -1 || (l.len > 0 ? l.frames[l.len - 1].sample + l.frames[l.len - 1].samples : 0) != c.samples)) {
+		fprintf(stderr, "Clip %llu in '%s' is damaged\n", (unsigned long long) clip, filepath);
+		rc = -1;
+	}
+
+	fs = rc == 0 ? flacstream_open(output, c.samples, seek_interval, NULL, NULL, 0) : NULL;
+	if (rc == 0 && fs == NULL) {
+		fprintf(stderr, "ERROR: could not open output file '%s'\n", output);
+		rc = -1;
+	}
+	for (i = 0; rc == 0 && i < l.len; i++) {
+		rc = flacstream_frame(fs, data + l.frames[i].offset, l.frames[i].bytes, l.frames[i].samples);
+	}
+	if (fs != NULL && flacstream_close(fs, NULL, NULL) == -1) {
+		rc = -1;
+	}
+	if (fs != NULL && rc == -1) {
+		fprintf(stderr, "ERROR: writing output file '%s'\n", output);
+	}
+
+	frames_free(&l);
+	free(data);
+
+	return rc;
+}
@@ -0,0 +1,185 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Waveforms shared between text-to-morse processes through POSIX shared
+ * memory. Hosts running many conversions at the same few settings would
+ * otherwise build the same dit, dah and silence in every process and keep
+ * a private copy each. With the cache enabled the first process to need a
+ * set of waveforms builds it in a named segment and marks it ready; every
+ * later one maps it read-only, so startup is an shm_open() and the pages
+ * are resident once per host instead of once per process.
+ *
+ * Entries are named after the program and cache versions, the user, the
+ * sample rate and the parameters, so a new build never maps an old layout.
+ * They are created 0600, and an existing entry is only mapped if it
+ * belongs to this user and nobody else can write it; otherwise another
+ * local user could create the name first and have their samples end up in
+ * this user's audio. A name taken that way is built privately. They last
+ * until reboot or until removed from /dev/shm. A process that finds an
+ * entry still being built waits up to SHMCACHE_WAIT_MS for it; if it
+ * isn't ready by then its builder is assumed dead, the entry is removed
+ * for the next process to rebuild, and the waveforms are built privately.
+ */
+
+#include "encoder.h"
+#include "shmcache.h"
+#include "version.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHMCACHE_MAGIC "TTMCACHE"
+
+/* in front of the samples of every entry; 64 bytes keeps them aligned */
+struct shmcache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t rate;
+	uint64_t nsamples;
+	uint64_t mapped;	/* bytes, header included */
+	atomic_int ready;	/* set once the samples are written */
+	unsigned char reserved[64 - 36];
+};
+
+static int shmcache_enabled = 0;
+
+void shmcache_enable(void) { shmcache_enabled = 1; }
+int shmcache_is_enabled(void) { return shmcache_enabled; }
+
+static void shmcache_sleep(void) {
+	struct timespec ts = { 0, 1000000 };
+
+	nanosleep(&ts, NULL);
+}
+
+/* map an entry someone else created, once it is complete and ready */
+static struct shmcache_header *shmcache_attach(const char *name, size_t bytes, size_t nsamples) {
+	struct shmcache_header *hdr = NULL;
+	struct stat st;
+	off_t size = 0;
+	int fd;
+	int waited;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	/* only trust entries this user made that no one else can change */
+	if (fstat(fd, &st) == -1 || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	for (waited = 0; waited < SHMCACHE_WAIT_MS; waited++) {
+		size = fstat(fd, &st) == 0 ? st.st_size : -1;
+		if (size == -1 || (size_t) size >= bytes) {
+			break;
+		}
+		shmcache_sleep();
+	}
+	if (waited < SHMCACHE_WAIT_MS && size == (off_t) bytes) {
+		hdr = (struct shmcache_header *) mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		hdr = hdr == MAP_FAILED ? NULL : hdr;
+	}
+	close(fd);
+
+	while (hdr != NULL && waited < SHMCACHE_WAIT_MS && !atomic_load_explicit(&hdr->ready, memory_order_acquire)) {
+		shmcache_sleep();
+		waited++;
+	}
+
+	if (waited == SHMCACHE_WAIT_MS) {
+		shm_unlink(name);
+	}
+	if (hdr != NULL && (waited == SHMCACHE_WAIT_MS || memcmp(hdr->magic, SHMCACHE_MAGIC, 8) != 0 || hdr->version != SHMCACHE_VERSION
+			|| hdr->rate != SAMPLE_RATE || hdr->nsamples != nsamples || hdr->mapped != bytes)) {
+		munmap(hdr, bytes);
+		hdr = NULL;
+	}
+
+	return hdr;
+}
+
+/*
+ * Find the `nsamples` long entry for `key`. If this process is the first,
+ * `build` is set to 1 and the samples must be filled in and handed to
+ * shmcache_ready(); otherwise the samples are already there, read-only.
+ * Returns NULL if there is no shared memory to be had, in which case the
+ * caller builds its own.
+ */
+int16_t *shmcache_open(const char *key, size_t nsamples, int *build) {
+	struct shmcache_header *hdr;
+	size_t bytes = sizeof(struct shmcache_header) + nsamples * sizeof(int16_t);
+	char name[128];
+	int fd;
+
+	snprintf(name, sizeof(name), "%s-%s-%d-%u-%d-%s", SHMCACHE_PREFIX, TEXT_TO_MORSE_PROJECT_VERSION, SHMCACHE_VERSION, (unsigned) geteuid(), SAMPLE_RATE, key);
+
+	*build = 0;
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1) {
+		hdr = errno == EEXIST ? shmcache_attach(name, bytes, nsamples) : NULL;
+		return hdr != NULL ? (int16_t *) (hdr + 1) : NULL;
+	}
+
+	hdr = ftruncate(fd, bytes) == -1 ? MAP_FAILED : (struct shmcache_header *) mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED) {
+		shm_unlink(name);
+		return NULL;
+	}
+
+	memcpy(hdr->magic, SHMCACHE_MAGIC, 8);
+	hdr->version = SHMCACHE_VERSION;
+	hdr->rate = SAMPLE_RATE;
+	hdr->nsamples = nsamples;
+	hdr->mapped = bytes;
+	*build = 1;
+
+	return (int16_t *) (hdr + 1);
+}
+
+/* publish an entry built after shmcache_open(); it is read-only from here on */
+const int16_t *shmcache_ready(int16_t *samples) {
+	struct shmcache_header *hdr = (struct shmcache_header *) samples - 1;
+
+	atomic_store_explicit(&hdr->ready, 1, memory_order_release);
+	mprotect(hdr, hdr->mapped, PROT_READ);
+
+	return samples;
+}
+
+void shmcache_close(const int16_t *samples) {
+	struct shmcache_header *hdr = (struct shmcache_header *) samples - 1;
+
+	munmap(hdr, hdr->mapped);
+}
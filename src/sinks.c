@@ -0,0 +1,176 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Extra outputs written from the same render as the main FLAC file. Each
+ * sink gets its own thread and reads the shared, already rendered samples
+ * (or the text, for key events), so one render feeds every format and the
+ * encoders run side by side.
+ */
+
+#include "encoder.h"
+#include "events.h"
+#include "npy.h"
+#include "sinks.h"
+#include "wav.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+struct sink {
+	char *filepath;
+	int kind;
+	int format;		/* EVENTS_* for SINK_EVENTS, NPY_* for SINK_NPY */
+	pthread_t thread;
+	int rc;
+
+	/* shared input, read only */
+	const int16_t *samples;
+	size_t nsamples;
+	const unsigned char *text;
+	size_t text_len;
+	int wpm;
+	int fwpm;
+};
+
+static const struct {
+	const char *extension;
+	int kind;
+	int format;
+} sink_extensions[] = {
+	{ ".flac", SINK_FLAC, 0 },
+	{ ".wav", SINK_WAV, 0 },
+	{ ".raw", SINK_RAW, 0 },
+	{ ".pcm", SINK_RAW, 0 },
+	{ ".csv", SINK_EVENTS, EVENTS_CSV },
+	{ ".json", SINK_EVENTS, EVENTS_JSON },
+	{ ".keys", SINK_EVENTS, EVENTS_BINARY },
+	{ ".npy", SINK_NPY, NPY_FLOAT32 },
+};
+
+static struct sink *sinks = NULL;
+static size_t nsinks = 0;
+
+size_t sinks_len(void) { return nsinks; }
+
+/* add an output; returns -1 if the extension isn't one we know */
+int sinks_add(char *filepath) {
+	struct sink *new_sinks;
+	const char *ext = strrchr(filepath, '.');
+	size_t i;
+
+	for (i = 0; ext != NULL && i < sizeof(sink_extensions) / sizeof(sink_extensions[0]); i++) {
+		if (strcasecmp(ext, sink_extensions[i].extension) == 0) {
+			break;
+		}
+	}
+	if (ext == NULL || i == sizeof(sink_extensions) / sizeof(sink_extensions[0])) {
+		return -1;
+	}
+
+	new_sinks = (struct sink *) realloc(sinks, (nsinks + 1) * sizeof(struct sink));
+	if (new_sinks == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sinks = new_sinks;
+
+	memset(&sinks[nsinks], 0, sizeof(struct sink));
+	sinks[nsinks].filepath = filepath;
+	sinks[nsinks].kind = sink_extensions[i].kind;
+	sinks[nsinks].format = sink_extensions[i].format;
+	if (sinks[nsinks].kind == SINK_NPY && ext - filepath >= 4 && strncasecmp(ext - 4, ".i16", 4) == 0) {
+		sinks[nsinks].format = NPY_INT16;
+	}
+	nsinks++;
+
+	return 0;
+}
+
+static void *sink_run(void *arg) {
+	struct sink *s = (struct sink *) arg;
+
+	switch (s->kind) {
+		case SINK_FLAC:
+			s->rc = encoder_encode(s->filepath, s->samples, s->nsamples, s->nsamples, NULL, NULL);
+			break;
+		case SINK_WAV:
+		case SINK_RAW:
+			s->rc = wav_write(s->filepath, s->samples, s->nsamples, SAMPLE_RATE, s->kind == SINK_WAV);
+			break;
+		case SINK_EVENTS:
+			s->rc = events_buffer(s->text, s->text_len, s->filepath, s->wpm, s->fwpm, s->format);
+			break;
+		case SINK_NPY:
+			s->rc = npy_write(s->filepath, s->samples, s->nsamples, s->format);
+			if (s->rc == 0) {
+				s->rc = npy_write_labels(s->filepath, s->text, s->text_len, s->wpm, s->fwpm);
+			}
+			break;
+	}
+
+	return NULL;
+}
+
+/* start writing every sink, one thread each; the input must stay put until sinks_wait() */
+void sinks_start(const int16_t *samples, size_t nsamples, const unsigned char *text, size_t text_len, int wpm, int fwpm) {
+	size_t i;
+
+	for (i = 0; i < nsinks; i++) {
+		sinks[i].samples = samples;
+		sinks[i].nsamples = nsamples;
+		sinks[i].text = text;
+		sinks[i].text_len = text_len;
+		sinks[i].wpm = wpm;
+		sinks[i].fwpm = fwpm;
+
+		if (pthread_create(&sinks[i].thread, NULL, sink_run, &sinks[i]) != 0) {
+			fprintf(stderr, "pthread_create failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/* wait for every sink; -1 if any of them failed */
+int sinks_wait(void) {
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < nsinks; i++) {
+		pthread_join(sinks[i].thread, NULL);
+		if (sinks[i].rc != 0) {
+			fprintf(stderr, "Could not write output file '%s'\n", sinks[i].filepath);
+			rc = -1;
+		}
+	}
+
+	return rc;
+}
+
+void sinks_exit(void) {
+	free(sinks);
+	sinks = NULL;
+	nsinks = 0;
+}
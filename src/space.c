@@ -19,58 +19,110 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "nsamples.h"
+#include "presets.h"
+#include "probes.h"
+#include "shmcache.h"
 #include "space.h"
 
 /* prebuilt waveforms for spaces */
-static int16_t *inter_character_space = NULL;	static size_t inter_character_space_len = 0;
-static int16_t *intra_character_space = NULL;	static size_t intra_character_space_len = 0;
-static int16_t *inter_word_space = NULL;	static size_t inter_word_space_len = 0;
+static const int16_t *inter_character_space = NULL;	static size_t inter_character_space_len = 0;
+static const int16_t *intra_character_space = NULL;	static size_t intra_character_space_len = 0;
+static const int16_t *inter_word_space = NULL;		static size_t inter_word_space_len = 0;
+static int space_allocated = 0;				/* 0 when sharing the build-time silence */
+static int space_shared = 0;				/* 1 when mapped from the shared memory cache */
 
-int16_t *space_get_inter_character(void)	{ return inter_character_space; }
+const int16_t *space_get_inter_character(void)	{ return inter_character_space; }
 size_t space_get_inter_character_len(void)	{ return inter_character_space_len; }
-int16_t *space_get_intra_character(void)	{ return intra_character_space; }
+const int16_t *space_get_intra_character(void)	{ return intra_character_space; }
 size_t space_get_intra_character_len(void)	{ return intra_character_space_len; }
-int16_t *space_get_inter_word_space(void)	{ return inter_word_space; }
+const int16_t *space_get_inter_word_space(void)	{ return inter_word_space; }
 size_t space_get_inter_word_len(void)		{ return inter_word_space_len; }
 
-/* writes silence of `nsamples` to `samples` */
-static void space_make(int16_t *samples, size_t nsamples) {
-	memset(samples, 0, sizeof(int16_t) * nsamples);
+/* allocate silence of `nsamples` */
+static int16_t *space_make(size_t nsamples) {
+	return (int16_t *) calloc(nsamples > 0 ? nsamples : 1, sizeof(int16_t));
 }
 
 /* Pre-render silence samples for space between elements, characters, and words */
 int space_init(int wpm, int fwpm) {
+#ifndef TEXT_TO_MORSE_NO_SHMCACHE
+	const int16_t *silence;
+	size_t silence_len;
+	char key[64];
+	int build;
+#endif
+
+	PROBE3(element_init_start, PROBE_ELEMENT_SPACE, wpm, fwpm);
+
 	inter_character_space_len = nsamples_inter_character_space(fwpm);
-	inter_character_space = (int16_t *) malloc(inter_character_space_len * sizeof(int16_t));
+	intra_character_space_len = nsamples_intra_character_space(wpm);
+	inter_word_space_len = nsamples_inter_word_space(fwpm);
+
+#ifndef TEXT_TO_MORSE_NO_PRESETS
+	/* silence is silence: every space that fits shares the build-time buffer */
+	if (inter_character_space_len <= presets_silence_len && intra_character_space_len <= presets_silence_len && inter_word_space_len <= presets_silence_len) {
+		inter_character_space = intra_character_space = inter_word_space = presets_silence;
+		space_allocated = 0;
+		PROBE4(element_init_done, PROBE_ELEMENT_SPACE, wpm, fwpm, PROBE_SOURCE_PRESET);
+		return 0;
+	}
+#endif
+
+#ifndef TEXT_TO_MORSE_NO_SHMCACHE
+	/* or the same, from a buffer shared with other processes */
+	if (shmcache_is_enabled()) {
+		silence_len = inter_character_space_len > intra_character_space_len ? inter_character_space_len : intra_character_space_len;
+		silence_len = inter_word_space_len > silence_len ? inter_word_space_len : silence_len;
+		snprintf(key, sizeof(key), "silence-%zu", silence_len);
+		silence = shmcache_open(key, silence_len, &build);
+		if (silence != NULL) {
+			silence = build ? shmcache_ready((int16_t *) silence) : silence;	/* shared memory starts out zeroed */
+			inter_character_space = intra_character_space = inter_word_space = silence;
+			space_allocated = 0;
+			space_shared = 1;
+			PROBE4(element_init_done, PROBE_ELEMENT_SPACE, wpm, fwpm, PROBE_SOURCE_SHARED);
+			return 0;
+		}
+	}
+#endif
+
+	space_allocated = 1;
+
+	inter_character_space = space_make(inter_character_space_len);
 	if (inter_character_space == NULL) {
 		return -1;
 	}
-	space_make(inter_character_space, inter_character_space_len);
 
-	intra_character_space_len = nsamples_intra_character_space(wpm);
-	intra_character_space = (int16_t *) malloc(intra_character_space_len * sizeof(int16_t));
+	intra_character_space = space_make(intra_character_space_len);
 	if (intra_character_space == NULL) {
 		return -1;
 	}
-	space_make(intra_character_space, intra_character_space_len);
 
-	inter_word_space_len = nsamples_inter_word_space(fwpm);
-	inter_word_space = (int16_t *) malloc(inter_word_space_len * sizeof(int16_t));
+	inter_word_space = space_make(inter_word_space_len);
 	if (inter_word_space == NULL) {
 		return -1;
 	}
-	space_make(inter_word_space, inter_word_space_len);
+
+	PROBE4(element_init_done, PROBE_ELEMENT_SPACE, wpm, fwpm, PROBE_SOURCE_RENDERED);
 
 	return 0;
 }
 
 /* clean-up silence */
 void space_exit(void) {
-	free(inter_character_space);	free(intra_character_space);	free(inter_word_space);
+	if (space_allocated) {
+		free((int16_t *) inter_character_space);	free((int16_t *) intra_character_space);	free((int16_t *) inter_word_space);
+	}
+#ifndef TEXT_TO_MORSE_NO_SHMCACHE
+	if (space_shared) {
+		shmcache_close(inter_character_space);
+	}
+#endif
 	inter_character_space		= intra_character_space		= inter_word_space	= NULL;
 	inter_character_space_len	= intra_character_space_len	= inter_word_space_len	= 0;
+	space_allocated			= space_shared			= 0;
 }
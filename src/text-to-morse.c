@@ -18,23 +18,48 @@
     SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include "align.h"
 #include "args.h"
+#include "decode.h"
+#include "dryrun.h"
 #include "encoder.h"
+#include "events.h"
+#include "incremental.h"
+#include "join.h"
+#include "kernels.h"
+#include "manifest.h"
+#include "measure.h"
 #include "morse.h"
 #include "nsamples.h"
+#include "normalize.h"
+#include "output.h"
+#include "pipeline.h"
+#include "realtime.h"
+#include "repeat.h"
 #include "render.h"
+#include "segment.h"
+#include "shard.h"
+#include "shmcache.h"
+#include "sinks.h"
 #include "space.h"
 #include "tone.h"
 #include "timing.h"
+#include "variant.h"
+#include "verify.h"
+#include "watch.h"
 #include "version.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-/* 18 wpm default, 600 Hz tone default */
+/* 18 wpm default, 600 Hz tone default, render on a single thread */
 #define WPM (18)
 #define FREQUENCY (600)
+#define JOBS (1)
 
 static int verbose = 0; /* verbose output, higher number === more verbosity */
 
@@ -51,6 +76,47 @@ int main(int argc, char *argv[]) {
 	int rc = 0;
 	int i = 0;
 	int frequency = FREQUENCY;
+	int queue_depth = OUTPUT_QUEUE_DEPTH;
+	int jobs = JOBS;
+	int seek_interval = SEEK_INTERVAL;
+	int embed_index = 0;
+	int dry_run = 0;
+	int decode = 0;
+	int frequency_set = 0;
+	int events = -1;
+	int segment_seconds = 0;
+	struct segment *segments = NULL;
+	size_t nsegments = 0;
+	struct measure m;
+	int pipeline = 0;
+	int realtime_ms = 0;
+	int watch = 0;
+	int join = 0;
+	int shard_mb = 0;
+	struct shard_stats shard_stats;
+	long long clip = -1;
+	char *end;
+	int repeat = 1;
+	double repeat_gap = -1;
+	size_t gap = 0;
+	char *variant_spec = NULL;
+	struct variant *variants = NULL;
+	size_t nvariants = 0;
+	struct realtime_stats realtime_stats;
+	struct pipeline_stats pipeline_stats;
+	int verified = 0;
+	struct verify *verifier = NULL;
+	struct decode_job *decoded;
+	char *manifest_file = NULL;
+	char *reuse_file = NULL;
+	unsigned char *text = NULL;
+	size_t text_len = 0;
+	size_t reused = 0;
+	struct manifest old;
+	struct manifest cur;
+	char *index_file = NULL;
+	unsigned char *index_data = NULL;
+	size_t index_len = 0;
 
 	uint64_t ms_started;
 	uint64_t ms_rendered;
@@ -59,19 +125,151 @@ int main(int argc, char *argv[]) {
 	struct prog_arg *arg;
 
 	static struct prog_arg args[] = {
+		{
+			.arg = 'a',
+			.longarg = "variants",
+			.description = "render the text once per comma separated WPM[/FWPM[/TONE]], e.g. 5,13/5,20/18/700, to OUTPUT-WPM-FWPM-TONE.flac files on -j workers",
+			.has_value = 1
+		},
+		{
+			.arg = 'b',
+			.longarg = "shard",
+			.description = "render every line of the input as its own clip, packed into shards of at most this many MiB next to OUTPUT, which becomes their index. Min 1. Max 1048576. Default 256.",
+			.has_value = 1
+		},
+		{
+			.arg = 'c',
+			.longarg = "repeat",
+			.description = "beacon: repeat the message this many times, encoding it only once. Min 1. Max 1000000. Default 1.",
+			.has_value = 1
+		},
+		{
+			.arg = 'd',
+			.longarg = "decode",
+			.description = "decode FLAC or WAVE files back to text: INPUT.FLAC... OUTPUT ('-' for stdout, a directory for several inputs). The tone is found unless -t is given.",
+			.has_value = 0
+		},
+		{
+			.arg = 'e',
+			.longarg = "events",
+			.description = "write key-down/key-up events instead of audio: bin, csv or json. OUTPUT '-' is stdout.",
+			.has_value = 1
+		},
+		{
+			.arg = 'E',
+			.longarg = "envelope",
+			.description = "shape of each tone's rise and fall: linear or cosine (raised cosine, softer clicks). Default linear.",
+			.has_value = 1
+		},
 		{
 			.arg = 'f',
 			.longarg = "fwpm",
 			.description = "Farnsworth spacing words per minute. Min 1. Max 100. Default 18.",
 			.has_value = 1
 		},
+		{
+			.arg = 'g',
+			.longarg = "gap",
+			.description = "seconds of silence after each repetition of -c (default one word space), or between the files of -J (default none). Min 0. Max 3600.",
+			.has_value = 1
+		},
 		PROG_ARG_HELP,
+		{
+			.arg = 'i',
+			.longarg = "clip",
+			.description = "write clip number N (from 0) of the shards made by -b to a FLAC file: INDEX OUTPUT.FLAC",
+			.has_value = 1
+		},
+		{
+			.arg = 'j',
+			.longarg = "jobs",
+			.description = "number of threads to render with. 0 uses one per CPU. Min 0. Max 256. Default 1.",
+			.has_value = 1
+		},
+		{
+			.arg = 'J',
+			.longarg = "join",
+			.description = "join FLAC files made by text-to-morse without re-encoding them: INPUT.FLAC... OUTPUT.FLAC",
+			.has_value = 0
+		},
+		{
+			.arg = 'k',
+			.longarg = "seek-interval",
+			.description = "seconds between seek points. 0 disables the seek table. Min 0. Max 3600. Default 10.",
+			.has_value = 1
+		},
+		{
+			.arg = 'm',
+			.longarg = "manifest",
+			.description = "save a render manifest (text, settings, frame offsets) to the given file; read it first when reusing",
+			.has_value = 1
+		},
+		{
+			.arg = 'n',
+			.longarg = "dry-run",
+			.description = "don't render; print samples, seconds and estimated FLAC bytes for each INPUT.TXT",
+			.has_value = 0
+		},
+		{
+			.arg = 'N',
+			.longarg = "no-verify",
+			.description = "don't check that the output decodes back to the rendered audio",
+			.has_value = 0
+		},
+		{
+			.arg = 'o',
+			.longarg = "output",
+			.description = "also write the same render to this file, by extension: .flac, .wav, .raw/.pcm (16-bit LE), .csv/.json/.keys (key events), .npy/.i16.npy (NumPy array plus .labels.npy). May be repeated.",
+			.has_value = 1
+		},
+		{
+			.arg = 'p',
+			.longarg = "pipeline",
+			.description = "read, render and encode at the same time on three threads instead of one after another",
+			.has_value = 0
+		},
+		{
+			.arg = 'q',
+			.longarg = "queue-depth",
+			.description = "asynchronous writes in flight when io_uring is available. 0 disables. Min 0. Max 4096. Default 64.",
+			.has_value = 1
+		},
+		{
+			.arg = 'r',
+			.longarg = "reuse",
+			.description = "previous output to reuse: only re-encode what changed since --manifest was saved",
+			.has_value = 1
+		},
+		{
+			.arg = 'R',
+			.longarg = "realtime",
+			.description = "stream raw 16-bit LE samples to OUTPUT ('-' for stdout) at the sample rate as the input arrives, this many ms ahead. Min 20. Max 10000.",
+			.has_value = 1
+		},
+		{
+			.arg = 's',
+			.longarg = "segment",
+			.description = "split the output into numbered files of about this many seconds, cut at word starts. Min 1. Max 86400.",
+			.has_value = 1
+		},
 		{
 			.arg = 't',
 			.longarg = "tone",
 			.description = "the frequency of the generated tone in Hertz. Min 300. Max 1200. Default 600.",
 			.has_value = 1
 		},
+		{
+			.arg = 'u',
+			.longarg = "normalize",
+			.description = "clean up the input first: uppercase it, drop characters with no morse code and collapse whitespace into single word gaps",
+			.has_value = 0
+		},
+		{
+			.arg = 'U',
+			.longarg = "substitute",
+			.description = "like -u, but send this character in place of characters with no morse code instead of dropping them",
+			.has_value = 1
+		},
 		{
 			.arg = 'v',
 			.longarg = "verbose",
@@ -84,12 +282,56 @@ int main(int argc, char *argv[]) {
 			.description = "words per minute. Min 1. Max 100. Default 18.",
 			.has_value = 1
 		},
+		{
+			.arg = 'W',
+			.longarg = "watch",
+			.description = "watch the given directories and convert each .txt file written there to .flac as soon as it is closed, on -j workers",
+			.has_value = 0
+		},
+		{
+			.arg = 'x',
+			.longarg = "index",
+			.description = "embed an index of word and line starts (text byte offset to sample offset) in the FLAC file",
+			.has_value = 0
+		},
+		{
+			.arg = 'X',
+			.longarg = "index-file",
+			.description = "write the index of word and line starts to the given text file",
+			.has_value = 1
+		},
+		{
+			.arg = 'y',
+			.longarg = "shm-cache",
+			.description = "share pre-rendered tones and silence with other text-to-morse processes through POSIX shared memory, building them only if no other process has",
+			.has_value = 0
+		},
 		PROG_ARG_END
 	};
 
 	static struct prog_example examples[] = {
 		{ .command = "text-to-morse hello.txt hello.flac", .description = "converts text file 'hello.txt' into a morse code audio file 'hello.flac'" },
 		{ .command = "text-to-morse -w 20 -f 12 -t 760 hello.txt hello.flac", .description = "convert hello.txt to hello.flac with 760 Hz tone, 20 WPM, 12 FWPM" },
+		{ .command = "text-to-morse -o hello.wav -o hello.csv hello.txt hello.flac", .description = "render hello.txt once and write it as FLAC, WAVE and key event CSV" },
+		{ .command = "text-to-morse -o hello.npy hello.txt hello.flac", .description = "also write hello.npy and hello.labels.npy for training a decoder" },
+		{ .command = "text-to-morse -a 5,13/5,20/18/700 -j 0 lesson.txt lesson.flac", .description = "write lesson-5-5-600.flac, lesson-13-5-600.flac and lesson-20-18-700.flac in one run" },
+		{ .command = "text-to-morse -c 8640 -g 5 beacon.txt beacon.flac", .description = "repeat the message in beacon.txt with 5 seconds between repetitions, for about a day" },
+		{ .command = "text-to-morse -s 300 -j 0 book.txt book.flac", .description = "split book into 5 minute files book-001.flac, book-002.flac, ... listed in book.segments" },
+		{ .command = "text-to-morse -u notes.txt notes.flac", .description = "convert notes.txt, skipping characters that have no morse code and extra whitespace" },
+		{ .command = "text-to-morse -p book.txt book.flac", .description = "convert a large book.txt, reading, rendering and encoding concurrently" },
+		{ .command = "text-to-morse -m script.manifest -r script.flac script.txt script.flac", .description = "re-export script.flac after editing script.txt, re-encoding only the edited part" },
+		{ .command = "text-to-morse -R 200 - - | aplay -t raw -f S16_LE -r 8000", .description = "key what is typed on standard input live, 200 ms ahead of the player" },
+		{ .command = "text-to-morse -W -j 4 spool/", .description = "convert every .txt file written into spool/ to .flac as it arrives, four at a time" },
+		{ .command = "text-to-morse -b 512 -j 0 phrases.txt phrases.idx", .description = "render every line of phrases.txt as a clip, packed into 512 MiB shards phrases-000000.shard, ... indexed by phrases.idx" },
+		{ .command = "text-to-morse -i 1234 phrases.idx clip.flac", .description = "write clip 1234 of those shards to clip.flac" },
+		{ .command = "text-to-morse -J -g 2 preamble.flac message.flac signoff.flac broadcast.flac", .description = "join three outputs with 2 seconds of silence between them, without re-encoding" },
+		{ .command = "text-to-morse -d hello.flac -", .description = "decode hello.flac back to text and print it" },
+		{ .command = "text-to-morse -d -j 0 corpus/*.flac texts", .description = "decode a corpus on every core, writing texts/NAME.txt for each corpus/NAME.flac" },
+		{ .command = "text-to-morse -e csv -w 20 hello.txt hello.csv", .description = "write the key-down/key-up times of hello.txt at 20 WPM as CSV, without rendering audio" },
+		{ .command = "text-to-morse -n -w 20 *.txt", .description = "print the exact duration and estimated file size of every .txt file at 20 WPM without rendering" },
+		{ .command = "text-to-morse -x -X book.idx book.txt book.flac", .description = "convert book.txt and index where every word starts, in book.flac and in book.idx" },
+		{ .command = "text-to-morse -E cosine -w 30 hello.txt hello.flac", .description = "convert hello.txt at 30 WPM with raised cosine keying for a cleaner spectrum" },
+		{ .command = "text-to-morse -y -w 22 -t 650 msg.txt msg.flac", .description = "map 22 wpm, 650 Hz tones built by an earlier or concurrent run instead of rendering them again" },
 		PROG_EXAMPLE_END
 	};
 
@@ -110,16 +352,111 @@ int main(int argc, char *argv[]) {
 
 	while ((arg = args_process(&prog, argc, argv)) != NULL) {
 		switch (arg->arg) {
+			case 'a':
+				variant_spec = argval;
+				break;
+			case 'b':
+				shard_mb = atoi(argval);
+				shard_mb = shard_mb < SHARD_MIN_MB || shard_mb > SHARD_MAX_MB ? SHARD_DEFAULT_MB : shard_mb;
+				break;
+			case 'c':
+				repeat = atoi(argval);
+				repeat = repeat < 1 || repeat > REPEAT_MAX ? 1 : repeat;
+				break;
+			case 'd':
+				decode = 1;
+				break;
+			case 'e':
+				events = events_format(argval);
+				if (events == -1) {
+					fprintf(stderr, "Unknown events format '%s', use bin, csv or json\n", argval);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'E':
+				if (tone_envelope_parse(argval) == -1) {
+					fprintf(stderr, "Unknown envelope '%s', use linear or cosine\n", argval);
+					exit(EXIT_FAILURE);
+				}
+				tone_set_envelope(tone_envelope_parse(argval));
+				break;
 			case 'f':
 				fwpm = atoi(argval);
 				fwpm = fwpm < 1 || fwpm > 100 ? 0 : fwpm;
 				break;
+			case 'g':
+				repeat_gap = atof(argval);
+				repeat_gap = repeat_gap < 0 || repeat_gap > REPEAT_MAX_GAP ? -1 : repeat_gap;
+				break;
 			case 'h':
 				args_show_help(&prog);
 				break;
+			case 'i':
+				clip = strtoll(argval, &end, 10);
+				if (end == argval || *end != '\0' || clip < 0) {
+					fprintf(stderr, "Invalid clip number '%s'\n", argval);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'j':
+				jobs = atoi(argval);
+				jobs = jobs < 0 || jobs > 256 ? JOBS : jobs;
+				break;
+			case 'J':
+				join = 1;
+				break;
+			case 'k':
+				seek_interval = atoi(argval);
+				seek_interval = seek_interval < 0 || seek_interval > 3600 ? SEEK_INTERVAL : seek_interval;
+				encoder_set_seek_interval(seek_interval);
+				break;
+			case 'm':
+				manifest_file = argval;
+				break;
+			case 'n':
+				dry_run = 1;
+				break;
+			case 'N':
+				verify_set_enabled(0);
+				break;
+			case 'o':
+				if (sinks_add(argval) == -1) {
+					fprintf(stderr, "Unknown output type '%s', use .flac, .wav, .raw, .pcm, .csv, .json, .keys or .npy\n", argval);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'p':
+				pipeline = 1;
+				break;
+			case 'q':
+				queue_depth = atoi(argval);
+				queue_depth = queue_depth < 0 || queue_depth > 4096 ? OUTPUT_QUEUE_DEPTH : queue_depth;
+				output_set_queue_depth(queue_depth);
+				break;
+			case 'r':
+				reuse_file = argval;
+				break;
+			case 'R':
+				realtime_ms = atoi(argval);
+				realtime_ms = realtime_ms < 20 || realtime_ms > 10000 ? 0 : realtime_ms;
+				break;
+			case 's':
+				segment_seconds = atoi(argval);
+				segment_seconds = segment_seconds < 1 || segment_seconds > 86400 ? 0 : segment_seconds;
+				break;
 			case 't':
 				frequency = atoi(argval);
 				frequency = frequency < 300 || frequency > 1200 ? FREQUENCY : frequency;
+				frequency_set = 1;
+				break;
+			case 'u':
+				normalize_enable(-1);
+				break;
+			case 'U':
+				if (strlen(argval) != 1 || normalize_enable((unsigned char) argval[0]) == -1) {
+					fprintf(stderr, "Can't substitute '%s', use a single character with a morse code\n", argval);
+					exit(EXIT_FAILURE);
+				}
 				break;
 			case 'v':
 				verbose += 1;
@@ -131,6 +468,20 @@ int main(int argc, char *argv[]) {
 				wpm = atoi(argval);
 				wpm = wpm < 1 || wpm > 100 ? WPM : wpm;
 				break;
+			case 'W':
+				watch = 1;
+				break;
+			case 'x':
+				embed_index = 1;
+				align_enable();
+				break;
+			case 'X':
+				index_file = argval;
+				align_enable();
+				break;
+			case 'y':
+				shmcache_enable();
+				break;
 		}
 
 	}
@@ -142,16 +493,189 @@ int main(int argc, char *argv[]) {
 		fwpm = wpm;
 	}
 
-	if (argc != 2) {
+	if (variant_spec != NULL) {
+		variants = variant_parse(variant_spec, frequency, &nvariants);
+		if (variants == NULL) {
+			fprintf(stderr, "Invalid variants '%s', use WPM[/FWPM[/TONE]],...\n", variant_spec);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (dry_run) {
+		struct measure m;
+
+		if (argc < 1) {
+			args_show_usage(&prog);
+		}
+
+		measure_init(&m, nsamples_dit(wpm), nsamples_dah(wpm), nsamples_intra_character_space(wpm), nsamples_inter_character_space(fwpm), nsamples_inter_word_space(fwpm));
+		for (i = 0; i < argc; i++) {
+			if (dryrun_file(argv[i], &m, seek_interval) == -1) {
+				rc = -1;
+			}
+		}
+
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (join) {
+		if (argc < 2) {
+			args_show_usage(&prog);
+		}
+
+		rc = join_files(argv, argc - 1, argv[argc - 1], repeat_gap < 0 ? 0 : (size_t) (repeat_gap * SAMPLE_RATE), seek_interval);
+
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (clip >= 0) {
+		if (argc != 2) {
+			args_show_usage(&prog);
+		}
+
+		rc = shard_extract(argv[0], (uint64_t) clip, argv[1], seek_interval, verbose);
+
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (watch ? argc < 1 : decode ? argc < 2 : argc != 2) {
 		args_show_usage(&prog);
 	}
 
-	input = fopen(argv[0], "r");
-	if (input == NULL) {
+	if (repeat > 1 && (pipeline || realtime_ms > 0 || manifest_file != NULL || embed_index || index_file != NULL || sinks_len() > 0 || segment_seconds > 0)) {
+		fprintf(stderr, "--repeat can't be combined with --pipeline, --realtime, --manifest, --index, --index-file, --output or --segment\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (variants != NULL && (decode || events != -1 || pipeline || realtime_ms > 0 || manifest_file != NULL || embed_index || index_file != NULL || sinks_len() > 0 || segment_seconds > 0 || repeat > 1)) {
+		fprintf(stderr, "--variants can't be combined with --decode, --events, --pipeline, --realtime, --manifest, --index, --index-file, --output, --segment or --repeat\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (watch && (variants != NULL || repeat > 1 || decode || events != -1 || pipeline || realtime_ms > 0 || manifest_file != NULL || embed_index || index_file != NULL || sinks_len() > 0 || segment_seconds > 0)) {
+		fprintf(stderr, "--watch can only be combined with the tone, speed, --jobs, --normalize and --no-verify options\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (shard_mb > 0 && (watch || variants != NULL || repeat > 1 || decode || events != -1 || pipeline || realtime_ms > 0 || manifest_file != NULL || embed_index || index_file != NULL || sinks_len() > 0 || segment_seconds > 0)) {
+		fprintf(stderr, "--shard can only be combined with the tone, speed, --jobs, --normalize and --no-verify options\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (jobs == 0) {
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+		jobs = jobs < 1 ? JOBS : jobs;
+	}
+
+	if (decode) {
+		decoded = (struct decode_job *) malloc((argc - 1) * sizeof(struct decode_job));
+		if (decoded == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+
+		rc = decode_files(argv, argc - 1, argv[argc - 1], frequency_set ? frequency : 0, jobs, decoded);
+
+		for (i = 0; verbose > 0 && i < argc - 1; i++) {
+			struct decode_stats *stats = &decoded[i].stats;
+
+			if (decoded[i].rc != 0) {
+				continue;
+			}
+			if (argc > 2) {
+				fprintf(stderr, "%s: ", decoded[i].filepath);
+			}
+			fprintf(stderr, "Tone: %d Hz\n", stats->frequency);
+			fprintf(stderr, "Speed: %.1f wpm\n", stats->wpm);
+			fprintf(stderr, "Characters: %zu (%zu unknown)\n", stats->characters, stats->unknown);
+		}
+		free(decoded);
+
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (events != -1) {
+		input = strcmp(argv[0], "-") == 0 ? stdin : fopen(argv[0], "r");
+		if (input == NULL) {
+			fprintf(stderr, "Could not open input file '%s'\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+
+		rc = events_file(input, argv[1], wpm, fwpm, events);
+
+		if (input != stdin) {
+			fclose(input);
+		}
+
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (reuse_file != NULL && manifest_file == NULL) {
+		fprintf(stderr, "--reuse needs the --manifest saved with the previous output\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (pipeline && (manifest_file != NULL || embed_index || sinks_len() > 0)) {
+		fprintf(stderr, "--pipeline can't be combined with --manifest, --index or --output\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (realtime_ms > 0 && (pipeline || manifest_file != NULL || embed_index || index_file != NULL || sinks_len() > 0 || segment_seconds > 0)) {
+		fprintf(stderr, "--realtime can't be combined with --pipeline, --manifest, --index, --index-file, --output or --segment\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!watch && output_is_descriptor(argv[1]) && (segment_seconds > 0 || reuse_file != NULL || shard_mb > 0)) {
+		fprintf(stderr, "--segment, --shard and --reuse need OUTPUT to be a file, not a descriptor\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (segment_seconds > 0 && (pipeline || manifest_file != NULL || embed_index)) {
+		fprintf(stderr, "--segment can't be combined with --pipeline, --manifest or --index\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* the index holds offsets into the text that was rendered, which --normalize rewrites */
+	if (normalize_is_enabled() && (embed_index || index_file != NULL)) {
+		fprintf(stderr, "--normalize can't be combined with --index or --index-file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	input = watch ? NULL : strcmp(argv[0], "-") == 0 ? stdin : fopen(argv[0], "r");
+	if (input == NULL && !watch) {
 		fprintf(stderr, "Could not open input file '%s'\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
+	if (variants != NULL) {
+		text = render_read(input, &text_len);
+		if (input != stdin) {
+			fclose(input);
+		}
+
+		if (variant_init(argv[1], variants, nvariants) == -1) {
+			fprintf(stderr, "Failed to initialize tones\n");
+			exit(EXIT_FAILURE);
+		}
+		rc = variant_encode(text, text_len, variants, nvariants, jobs, &verified);
+
+		if (verbose > 0) {
+			fprintf(stdout, "Variants: %zu\n", nvariants);
+			fprintf(stdout, "Time: %llu ms\n", (unsigned long long) (now_ms() - ms_started));
+			if (verified != 0) {
+				fprintf(stdout, "Verified: %s\n", verified == 1 ? "yes" : "no");
+			}
+		}
+
+		free(text);
+		variant_free(variants, nvariants);
+
+		if (rc == 0 && verified == -1) {
+			exit(VERIFY_EXIT_FAILURE);
+		}
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	rc = space_init(wpm, fwpm);
 	if (rc == -1) {
 		fprintf(stderr, "Failed to initialize space\n");
@@ -164,27 +688,197 @@ int main(int argc, char *argv[]) {
 		exit(EXIT_FAILURE);
 	}
 
-	render_text(input);
+	if (watch) {
+		rc = watch_run(argv, argc, jobs, verbose);
+
+		tone_exit();
+		space_exit();
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (shard_mb > 0) {
+		text = render_read(input, &text_len);
+		if (input != stdin) {
+			fclose(input);
+		}
+
+		rc = shard_pack(text, text_len, argv[1], (uint64_t) shard_mb << 20, wpm, fwpm, frequency, jobs, &shard_stats);
+
+		if (verbose > 0) {
+			fprintf(stdout, "Clips: %zu\n", shard_stats.clips);
+			fprintf(stdout, "Shards: %zu\n", shard_stats.shards);
+			fprintf(stdout, "Time: %llu ms\n", (unsigned long long) (now_ms() - ms_started));
+			if (shard_stats.verified != 0) {
+				fprintf(stdout, "Verified: %s\n", shard_stats.verified == 1 ? "yes" : "no");
+			}
+		}
+
+		free(text);
+		tone_exit();
+		space_exit();
+
+		if (rc == 0 && shard_stats.verified == -1) {
+			exit(VERIFY_EXIT_FAILURE);
+		}
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (realtime_ms > 0) {
+		rc = realtime_run(input, argv[1], realtime_ms, &realtime_stats);
+
+		/* stdout may be the audio */
+		fprintf(stderr, "Streamed: %.3f s\n", (double) realtime_stats.samples / SAMPLE_RATE);
+		fprintf(stderr, "Latency: min %.1f ms, avg %.1f ms, max %.1f ms\n", realtime_stats.latency_min / 1000.0,
+			realtime_stats.latency_count > 0 ? realtime_stats.latency_sum / 1000.0 / realtime_stats.latency_count : 0.0,
+			realtime_stats.latency_max / 1000.0);
+		if (realtime_stats.latency_unmeasured > 0) {
+			fprintf(stderr, "Latency Unmeasured: %zu reads\n", realtime_stats.latency_unmeasured);
+		}
+		fprintf(stderr, "Jitter: avg %.3f ms, max %.3f ms\n",
+			realtime_stats.jitter_count > 0 ? realtime_stats.jitter_sum / 1000.0 / realtime_stats.jitter_count : 0.0,
+			realtime_stats.jitter_max / 1000.0);
+		fprintf(stderr, "Underruns: %zu\n", realtime_stats.underruns);
+
+		tone_exit();
+		space_exit();
+		exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (pipeline) {
+		rc = pipeline_run(input, argv[1], &pipeline_stats);
+		verified = pipeline_stats.verified;
+	} else if (manifest_file != NULL || sinks_len() > 0 || segment_seconds > 0 || normalize_is_enabled()) {
+		text = render_read(input, &text_len);
+		render_buffer(text, text_len, jobs);
+	} else if (jobs > 1) {
+		render_text_parallel(input, jobs);
+	} else {
+		render_text(input);
+	}
+
+	if (segment_seconds > 0) {
+		render_measure(&m);
+		segments = segment_plan(text, text_len, &m, (size_t) segment_seconds * SAMPLE_RATE, &nsegments);
+	}
+
+	if (repeat > 1) {
+		gap = repeat_gap < 0 ? space_get_inter_word_len() : (size_t) (repeat_gap * SAMPLE_RATE);
+	}
 
 	tone_exit();
 	space_exit();
 
-	fclose(input);
+	if (input != stdin) {
+		fclose(input);
+	}
+
+	if (index_file != NULL && align_write(index_file) == -1) {
+		fprintf(stderr, "Could not write index file '%s'\n", index_file);
+		exit(EXIT_FAILURE);
+	}
+
+	if (embed_index) {
+		index_data = align_serialize(&index_len);
+		if (index_len + 4 > 0xffffff) { /* FLAC metadata blocks are limited to 24-bit lengths */
+			fprintf(stderr, "Index too large to embed, use --index-file instead\n");
+			exit(EXIT_FAILURE);
+		}
+		encoder_set_application(ALIGN_APPLICATION_ID, index_data, index_len);
+	}
 
 	ms_rendered = now_ms();
 
-	rc = encoder_encode(argv[1], render_get_buf(), render_get_buf_len(), render_get_total_samples());
+	memset(&cur, 0, sizeof(struct manifest));
+	cur.wpm = wpm;
+	cur.fwpm = fwpm;
+	cur.frequency = frequency;
+	cur.envelope = tone_get_envelope();
+	cur.text = text;
+	cur.text_len = text_len;
+	cur.total_samples = render_get_total_samples();
+
+	/* extra outputs are written on their own threads alongside the main one */
+	sinks_start(render_get_buf(), render_get_total_samples(), text, text_len, wpm, fwpm);
+
+	/* with --pipeline the output has already been encoded */
+	rc = pipeline ? rc : 1;
+	if (reuse_file != NULL) {
+		if (manifest_read(manifest_file, &old) == 0) {
+			rc = incremental_encode(argv[1], reuse_file, &old, &cur, render_get_buf(), seek_interval, ALIGN_APPLICATION_ID, index_data, index_len, &reused);
+			if (rc == 0 && verbose > 0) {
+				fprintf(stdout, "Reused Frames: %zu of %zu\n", reused, cur.frames.len);
+			}
+			manifest_free(&old);
+		}
+		if (rc == 1 && verbose > 0) {
+			fprintf(stdout, "Previous output can't be reused, encoding everything\n");
+		}
+	}
+
+	if (rc == 1 && repeat > 1) {
+		rc = repeat_encode(argv[1], render_get_buf(), render_get_total_samples(), gap, repeat, seek_interval, &verified);
+		if (verbose > 0) {
+			fprintf(stdout, "Repetitions: %d\n", repeat);
+		}
+	} else if (rc == 1 && segments != NULL) {
+		rc = segment_encode(argv[1], render_get_buf(), segments, nsegments, jobs, &verified);
+		if (rc == 0 && segment_write_manifest(argv[1], segments, nsegments) == -1) {
+			rc = -1;
+		}
+		if (verbose > 0) {
+			fprintf(stdout, "Segments: %zu\n", nsegments);
+		}
+	} else if (rc == 1) {
+		/* decode what the encoder writes on another thread while it's still encoding */
+		if (verify_is_enabled()) {
+			verifier = verify_start(render_get_buf(), render_get_total_samples());
+		}
+		rc = encoder_encode(argv[1], render_get_buf(), render_get_buf_len(), render_get_total_samples(), verifier, &cur.frames);
+		if (verifier != NULL) {
+			verified = verify_finish(verifier) == 0 ? 1 : -1;
+		}
+	} else if (rc == 0 && reuse_file != NULL && verify_is_enabled()) {
+		/* frames copied from the previous output weren't seen by an encoder, decode the file */
+		verified = verify_file(argv[1], render_get_buf(), render_get_total_samples()) == 0 ? 1 : -1;
+	}
+
+	if (sinks_wait() == -1) {
+		rc = -1;
+	}
+
+	if (rc == 0 && manifest_file != NULL && manifest_write(manifest_file, &cur) == -1) {
+		fprintf(stderr, "Could not write manifest file '%s'\n", manifest_file);
+		rc = -1;
+	}
+	manifest_free(&cur);
 
 	ms_encoded = now_ms();
 
 	if (verbose > 0) {
 
-		fprintf(stdout, "Render Time: %llu ms\n", ms_rendered - ms_started);
-		fprintf(stdout, "Encode Time: %llu ms\n", ms_encoded - ms_rendered);
+		if (pipeline) {
+			fprintf(stdout, "Pipeline Time: %" PRIu64 " ms\n", ms_rendered - ms_started);
+			fprintf(stdout, "Total Samples: %zu\n", pipeline_stats.total_samples);
+		} else {
+			fprintf(stdout, "Render Time: %" PRIu64 " ms\n", ms_rendered - ms_started);
+			fprintf(stdout, "Encode Time: %" PRIu64 " ms\n", ms_encoded - ms_rendered);
+		}
 		fprintf(stdout, "Memory Usage: %lu bytes\n", render_get_buf_len());
+		fprintf(stdout, "Kernels: %s\n", kernels_get()->name);
+		if (verified != 0) {
+			fprintf(stdout, "Verified: %s\n", verified == 1 ? "yes" : "no");
+		}
 	}
 
 	render_exit();
+	align_exit();
+	sinks_exit();
+	segment_free(segments, nsegments);
+	free(index_data);
+
+	if (rc == 0 && verified == -1) {
+		exit(VERIFY_EXIT_FAILURE);
+	}
 
 	exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
 }
@@ -20,6 +20,7 @@
 
 #include "timing.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/time.h>
 
@@ -19,26 +19,98 @@
  */
 
 #include "encoder.h"
+#include "kernels.h"
 #include "nsamples.h"
+#include "presets.h"
+#include "probes.h"
+#include "shmcache.h"
 #include "tone.h"
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 /* prebuilt waveforms for dit, dah, and spaces */
-static int16_t *dit_tone = NULL;		static size_t dit_tone_len = 0;
-static int16_t *dah_tone = NULL;		static size_t dah_tone_len = 0;
+static const int16_t *dit_tone = NULL;		static size_t dit_tone_len = 0;
+static const int16_t *dah_tone = NULL;		static size_t dah_tone_len = 0;
+static int tone_allocated = 0;			/* 0 when pointing at build-time presets */
+static int tone_shared = 0;			/* 1 when mapped from the shared memory cache */
+static int tone_envelope = TONE_ENVELOPE_LINEAR;
+
+/* the shape of each tone's rise and fall, for the following tone_init() calls */
+void tone_set_envelope(int envelope)	{ tone_envelope = envelope;	}
+int tone_get_envelope(void)		{ return tone_envelope;	}
+
+/* TONE_ENVELOPE_* for a name, or -1 */
+int tone_envelope_parse(const char *name) {
+	if (strcmp(name, "linear") == 0) {
+		return TONE_ENVELOPE_LINEAR;
+	} else if (strcmp(name, "cosine") == 0) {
+		return TONE_ENVELOPE_COSINE;
+	}
+
+	return -1;
+}
+
+const int16_t *tone_get_dit(void)	{ return dit_tone;	}
+size_t  tone_get_dit_len(void)		{ return dit_tone_len;	}
+const int16_t *tone_get_dah(void)	{ return dah_tone;	}
+size_t  tone_get_dah_len(void)		{ return dah_tone_len;	}
+
+/* gain at the start and end of every tone, worked out once per tone_init() */
+struct tone_ramps {
+	double *rise;	size_t rise_len;	/* rise[i]: gain of sample i */
+	double *fall;	size_t fall_len;	/* fall[k]: gain of the sample k before the end */
+};
+
+/* build the ramps for `envelope`; linear is what tone_make() always did, i/rise_time */
+static int tone_ramps_init(struct tone_ramps *r, int rise_time, int fall_time, int envelope) {
+	size_t i;
+
+	r->rise_len = rise_time;
+	r->fall_len = fall_time;
+	r->rise = (double *) malloc((r->rise_len + r->fall_len + 1) * sizeof(double));
+	if (r->rise == NULL) {
+		return -1;
+	}
+	r->fall = r->rise + r->rise_len;
+
+	for (i = 0; i < r->rise_len; i++) {
+		r->rise[i] = envelope == TONE_ENVELOPE_COSINE ? 0.5 - 0.5 * cos(M_PI * i / rise_time) : i * 1.0 / rise_time * 1.0;
+	}
+	for (i = 0; i < r->fall_len; i++) {
+		r->fall[i] = envelope == TONE_ENVELOPE_COSINE ? 0.5 - 0.5 * cos(M_PI * i / fall_time) : i * 1.0 / fall_time * 1.0;
+	}
 
-int16_t *tone_get_dit(void)	{ return dit_tone;	}
-size_t  tone_get_dit_len(void)	{ return dit_tone_len;	}
-int16_t *tone_get_dah(void)	{ return dah_tone;	}
-size_t  tone_get_dah_len(void)	{ return dah_tone_len;	}
+	return 0;
+}
+
+static void tone_ramps_free(struct tone_ramps *r) {
+	free(r->rise);
+	r->rise = r->fall = NULL;
+}
 
 /*
- * Writes a sine wave of `nsamples` to `samples` at `frequency` with the given `rise_time` and `fall_time`
+ * Writes a sine wave of `nsamples` to `samples` at `frequency`, shaped by the ramps `r`.
+ *
+ * Instead of a sin() per sample, KERNELS_TONE_LANES phasors a sample
+ * apart are each rotated KERNELS_TONE_LANES samples at a time, by the
+ * fastest phasor kernel the CPU runs (kernels.h). Every TONE_RESYNC
+ * samples the phasors restart from sin()/cos() of the exact phase so
+ * rounding can't accumulate. The result matches the former per-sample
+ * sin() to within 1 LSB.
  */
-static void tone_make(int16_t *samples, size_t nsamples, int rise_time, int fall_time, int frequency) {
-	int i;
+static void tone_make(int16_t *samples, size_t nsamples, const struct tone_ramps *r, int frequency) {
+	const struct kernels *kernels = kernels_get();
+	const double w = 2 * M_PI * frequency / SAMPLE_RATE;
+	const double step_re = cos(KERNELS_TONE_LANES * w);
+	const double step_im = sin(KERNELS_TONE_LANES * w);
+	double re[KERNELS_TONE_LANES];
+	double im[KERNELS_TONE_LANES];
+	size_t i;
+	size_t k;
 
 	int volume = 0;
 
@@ -49,14 +121,20 @@ static void tone_make(int16_t *samples, size_t nsamples, int rise_time, int fall
 
 	volume = volume * 0.50119; /* peak at -3db */
 
-	for (i = 0; i < nsamples; i++) {
-		double t = (double) i / SAMPLE_RATE;
-		samples[i] = volume * sin(frequency*t*2*M_PI);
+	for (i = 0; i < nsamples; i += TONE_RESYNC) {
+		for (k = 0; k < KERNELS_TONE_LANES; k++) {
+			re[k] = cos(w * (i + k));
+			im[k] = sin(w * (i + k));
+		}
+		kernels->phasor(samples + i, nsamples - i < TONE_RESYNC ? nsamples - i : TONE_RESYNC, re, im, step_re, step_im, volume);
+	}
 
-		if (i < rise_time) {
-			samples[i] = samples[i] * (i*1.0/rise_time*1.0);
-		} else if (i > nsamples - fall_time) {
-			samples[i] = samples[i] * ((nsamples-i)*1.0/fall_time*1.0);
+	for (i = 0; i < nsamples && i < r->rise_len; i++) {
+		samples[i] = samples[i] * r->rise[i];
+	}
+	for (k = 1; k < r->fall_len && k <= nsamples; k++) {
+		if (nsamples - k >= r->rise_len) {
+			samples[nsamples - k] = samples[nsamples - k] * r->fall[k];
 		}
 	}
 }
@@ -66,33 +144,100 @@ static void tone_make(int16_t *samples, size_t nsamples, int rise_time, int fall
  */
 int tone_init(int wpm, int frequency) {
 
-	int rise_time;
-	int fall_time;
+	struct tone_ramps ramps;
+	int16_t *samples;
+#ifndef TEXT_TO_MORSE_NO_SHMCACHE
+	char key[64];
+	int build;
+#endif
+
+#ifndef TEXT_TO_MORSE_NO_PRESETS
+	const struct preset *preset;
+#endif
+
+	PROBE3(element_init_start, PROBE_ELEMENT_TONE, wpm, frequency);
+
+#ifndef TEXT_TO_MORSE_NO_PRESETS
+	preset = tone_envelope == TONE_ENVELOPE_LINEAR ? presets_find(wpm, frequency) : NULL;
+
+	/* common settings were rendered at build time */
+	if (preset != NULL) {
+		dit_tone = preset->dit;		dit_tone_len = preset->dit_len;
+		dah_tone = preset->dah;		dah_tone_len = preset->dah_len;
+		tone_allocated = 0;
+		PROBE4(element_init_done, PROBE_ELEMENT_TONE, wpm, frequency, PROBE_SOURCE_PRESET);
+		return 0;
+	}
+#endif
 
-	rise_time = nsamples_rise_time(wpm);
-	fall_time = nsamples_fall_time(wpm);
+	if (tone_ramps_init(&ramps, nsamples_rise_time(wpm), nsamples_fall_time(wpm), tone_envelope) == -1) {
+		return -1;
+	}
+
+#ifndef TEXT_TO_MORSE_NO_SHMCACHE
+	/* other processes may have rendered these already */
+	if (shmcache_is_enabled()) {
+		dit_tone_len = nsamples_dit(wpm);
+		dah_tone_len = nsamples_dah(wpm);
+		snprintf(key, sizeof(key), "tone-%d-%d%s", wpm, frequency, tone_envelope == TONE_ENVELOPE_COSINE ? "-cosine" : "");
+		samples = shmcache_open(key, dit_tone_len + dah_tone_len, &build);
+		if (samples != NULL) {
+			if (build) {
+				tone_make(samples, dit_tone_len, &ramps, frequency);
+				tone_make(samples + dit_tone_len, dah_tone_len, &ramps, frequency);
+				shmcache_ready(samples);
+			}
+			dit_tone = samples;
+			dah_tone = samples + dit_tone_len;
+			tone_allocated = 0;
+			tone_shared = 1;
+			tone_ramps_free(&ramps);
+			PROBE4(element_init_done, PROBE_ELEMENT_TONE, wpm, frequency, PROBE_SOURCE_SHARED);
+			return 0;
+		}
+	}
+#endif
+
+	tone_allocated = 1;
 
 	dit_tone_len = nsamples_dit(wpm);
-	dit_tone = (int16_t *) malloc(dit_tone_len * sizeof(int16_t));
-	if (dit_tone == NULL) {
+	samples = (int16_t *) malloc(dit_tone_len * sizeof(int16_t));
+	if (samples == NULL) {
+		tone_ramps_free(&ramps);
 		return -1;
 	}
-	tone_make(dit_tone, dit_tone_len, rise_time, fall_time, frequency);
+	tone_make(samples, dit_tone_len, &ramps, frequency);
+	dit_tone = samples;
 
 	dah_tone_len = nsamples_dah(wpm);
-	dah_tone = (int16_t *) malloc(dah_tone_len * sizeof(int16_t));
-	if (dah_tone == NULL) {
+	samples = (int16_t *) malloc(dah_tone_len * sizeof(int16_t));
+	if (samples == NULL) {
+		tone_ramps_free(&ramps);
 		return -1;
 	}
-	tone_make(dah_tone, dah_tone_len, rise_time, fall_time, frequency);
+	tone_make(samples, dah_tone_len, &ramps, frequency);
+	dah_tone = samples;
+
+	tone_ramps_free(&ramps);
+
+	PROBE4(element_init_done, PROBE_ELEMENT_TONE, wpm, frequency, PROBE_SOURCE_RENDERED);
 
 	return 0;
 }
 
 /* clean-up dit and dah samples */
 void tone_exit(void) {
-	free(dit_tone);	free(dah_tone);
+	if (tone_allocated) {
+		free((int16_t *) dit_tone);	free((int16_t *) dah_tone);
+	}
+#ifndef TEXT_TO_MORSE_NO_SHMCACHE
+	if (tone_shared) {
+		shmcache_close(dit_tone);
+	}
+	tone_shared	= 0;
+#endif
 	dit_tone	= dah_tone	= NULL;
 	dit_tone_len	= dah_tone_len	= 0;
+	tone_allocated	= 0;
 }
 
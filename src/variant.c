@@ -0,0 +1,253 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Several variants of one text in one run: every wpm/fwpm/tone
+ * combination of a lesson, say. The text is read (and normalized) once.
+ * Each variant's elements are set up with tone_init() and space_init()
+ * in turn and copied, since those keep one set at a time, then the
+ * variants are rendered and encoded on a pool of workers, each into its
+ * own buffer and file.
+ *
+ * lesson.flac with 20/15/700 becomes lesson-20-15-700.flac.
+ */
+
+#include "encoder.h"
+#include "measure.h"
+#include "output.h"
+#include "render.h"
+#include "space.h"
+#include "tone.h"
+#include "variant.h"
+#include "verify.h"
+#include "work.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* what the rendering threads share */
+struct variant_pool {
+	const unsigned char *text;
+	size_t len;
+	struct variant *variants;
+};
+
+/* read a number in [min, max] from `*p`; an empty field gives `def` */
+static int variant_number(const char **p, int min, int max, int def, int *v) {
+	char *end;
+	long n;
+
+	if (**p == '/' || **p == ',' || **p == '\0') {
+		*v = def;
+		return 0;
+	}
+
+	n = strtol(*p, &end, 10);
+	if (end == *p || n < min || n > max) {
+		return -1;
+	}
+	*p = end;
+	*v = (int) n;
+
+	return 0;
+}
+
+/*
+ * Parse a comma separated list of WPM[/FWPM[/TONE]] variants. FWPM
+ * defaults to WPM, TONE to `frequency`. Returns NULL if `spec` isn't
+ * valid.
+ */
+struct variant *variant_parse(const char *spec, int frequency, size_t *nvariants) {
+	struct variant *variants;
+	struct variant *v;
+	const char *p = spec;
+	int ok = 1;
+
+	variants = (struct variant *) calloc(VARIANT_MAX, sizeof(struct variant));
+	if (variants == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	*nvariants = 0;
+	while (ok && *nvariants < VARIANT_MAX) {
+		v = &variants[*nvariants];
+
+		ok = variant_number(&p, 1, 100, 0, &v->wpm) == 0 && v->wpm != 0;
+		if (ok && *p == '/') {
+			p++;
+			ok = variant_number(&p, 1, 100, v->wpm, &v->fwpm) == 0;
+		} else {
+			v->fwpm = v->wpm;
+		}
+		if (ok && *p == '/') {
+			p++;
+			ok = variant_number(&p, 300, 1200, frequency, &v->frequency) == 0;
+		} else {
+			v->frequency = frequency;
+		}
+		(*nvariants)++;
+
+		if (!ok || *p == '\0') {
+			break;
+		}
+		ok = *p == ',';
+		p++;
+	}
+
+	if (!ok || *p != '\0') {
+		free(variants);
+		return NULL;
+	}
+
+	return variants;
+}
+
+/* copy `len` samples, since the originals go away with tone_exit() and space_exit() */
+static const int16_t *variant_copy(const int16_t *src, size_t len) {
+	int16_t *dst;
+
+	dst = (int16_t *) malloc((len > 0 ? len : 1) * sizeof(int16_t));
+	if (dst == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(dst, src, len * sizeof(int16_t));
+
+	return dst;
+}
+
+/* lesson.flac -> lesson-20-15-700.flac */
+static char *variant_name(const char *filepath, const struct variant *v) {
+	char suffix[48];
+
+	sprintf(suffix, "-%d-%d-%d", v->wpm, v->fwpm, v->frequency);
+
+	return output_name(filepath, suffix, NULL);
+}
+
+/*
+ * Set up every variant's elements and output file name next to
+ * `filepath`. Leaves tone and space uninitialized. Returns 0 on success,
+ * -1 if any variant's elements can't be set up.
+ */
+int variant_init(char *filepath, struct variant *variants, size_t nvariants) {
+	struct elements e;
+	struct variant *v;
+	size_t i;
+
+	for (i = 0; i < nvariants; i++) {
+		v = &variants[i];
+
+		if (space_init(v->wpm, v->fwpm) == -1 || tone_init(v->wpm, v->frequency) == -1) {
+			return -1;
+		}
+
+		render_elements(&e);
+		v->e.dit = variant_copy(e.dit, e.dit_len);				v->e.dit_len = e.dit_len;
+		v->e.dah = variant_copy(e.dah, e.dah_len);				v->e.dah_len = e.dah_len;
+		v->e.intra_character = variant_copy(e.intra_character, e.intra_character_len);	v->e.intra_character_len = e.intra_character_len;
+		v->e.inter_character = variant_copy(e.inter_character, e.inter_character_len);	v->e.inter_character_len = e.inter_character_len;
+		v->e.inter_word = variant_copy(e.inter_word, e.inter_word_len);		v->e.inter_word_len = e.inter_word_len;
+		measure_init(&v->m, e.dit_len, e.dah_len, e.intra_character_len, e.inter_character_len, e.inter_word_len);
+
+		tone_exit();
+		space_exit();
+
+		v->filepath = variant_name(filepath, v);
+	}
+
+	return 0;
+}
+
+static int variant_worker(void *arg, size_t i) {
+	struct variant_pool *pool = (struct variant_pool *) arg;
+	struct variant *v = &pool->variants[i];
+	struct verify *verifier;
+	int16_t *samples;
+
+	v->samples = measure_text(&v->m, pool->text, pool->len, 0);
+	samples = (int16_t *) malloc((v->samples > 0 ? v->samples : 1) * sizeof(int16_t));
+	if (samples == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	render_span_elements(&v->e, samples, pool->text, pool->len, 0);
+
+	verifier = verify_is_enabled() ? verify_start(samples, v->samples) : NULL;
+	v->rc = encoder_encode(v->filepath, samples, v->samples, v->samples, verifier, NULL);
+	if (verifier != NULL) {
+		v->verified = verify_finish(verifier) == 0 ? 1 : -1;
+	}
+
+	free(samples);
+
+	return 0;
+}
+
+/*
+ * Render `text` in every variant and encode each to its own file, on
+ * `jobs` threads. `verified` is set like for a single output: 1 all
+ * passed, -1 any failed, 0 not verified.
+ */
+int variant_encode(const unsigned char *text, size_t len, struct variant *variants, size_t nvariants, int jobs, int *verified) {
+	struct variant_pool pool;
+	size_t i;
+	int rc = 0;
+
+	pool.text = text;
+	pool.len = len;
+	pool.variants = variants;
+	work_run(nvariants, jobs, variant_worker, &pool);
+
+	*verified = 0;
+	for (i = 0; i < nvariants; i++) {
+		if (variants[i].rc != 0) {
+			fprintf(stderr, "Could not write output file '%s'\n", variants[i].filepath);
+			rc = -1;
+		}
+		if (variants[i].verified == -1 || (variants[i].verified == 1 && *verified == 0)) {
+			*verified = variants[i].verified;
+		}
+	}
+
+	return rc;
+}
+
+void variant_free(struct variant *variants, size_t nvariants) {
+	size_t i;
+
+	if (variants == NULL) {
+		return;
+	}
+
+	for (i = 0; i < nvariants; i++) {
+		free((int16_t *) variants[i].e.dit);
+		free((int16_t *) variants[i].e.dah);
+		free((int16_t *) variants[i].e.intra_character);
+		free((int16_t *) variants[i].e.inter_character);
+		free((int16_t *) variants[i].e.inter_word);
+		free(variants[i].filepath);
+	}
+	free(variants);
+}
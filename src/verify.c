@@ -0,0 +1,490 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Checks that the encoded output decodes back to the rendered audio. The
+ * encoded bytes are handed over as they are written and decoded on a
+ * separate thread, so verification overlaps encoding instead of running
+ * inside libFLAC's encode loop. Once the stream ends, the sample count
+ * and the MD5 of the decoded audio are compared with the rendered source.
+ *
+ * The decoder only sees the stream up to libFLAC's seek back to fill in
+ * STREAMINFO and the seek table, so once the file is closed its metadata
+ * is read back too (verify_output()): the sample count and MD5 in
+ * STREAMINFO must match the source, and every seek point must name the
+ * first sample and offset of a frame the encoder wrote.
+ *
+ * At most VERIFY_QUEUE_BYTES wait for the decoder; past that the encoder
+ * waits for it to catch up rather than queueing the whole output.
+ */
+
+#include "bytes.h"
+#include "encoder.h"
+#include "frames.h"
+#include "md5.h"
+#include "output.h"
+#include "verify.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FLAC/stream_decoder.h>
+
+#define VERIFY_READSIZE (65536)
+
+/* a block of encoded bytes waiting to be decoded */
+struct verify_chunk {
+	struct verify_chunk *next;
+	size_t len;
+	size_t pos;
+	unsigned char data[];
+};
+
+struct verify {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	pthread_cond_t room;
+	struct verify_chunk *head;
+	struct verify_chunk *tail;
+	size_t queued;	/* bytes in the chunks */
+	int eof;
+	int done;	/* the decoder stopped; anything fed from now on is dropped */
+
+	/* the finished file's STREAMINFO, read by verify_output() on the encoding thread */
+	int checked;
+	int bad_output;
+	uint64_t total_samples;
+	unsigned char md5sum[16];
+
+	/* only touched by the verify thread until it is joined */
+	const int16_t *samples;
+	size_t nsamples;
+	size_t decoded;
+	int failed;
+	struct md5 md5;
+	int16_t pcm[VERIFY_MAX_BLOCKSIZE];
+};
+
+static int enabled = 1;
+
+void verify_set_enabled(int e) { enabled = e; }
+int verify_is_enabled(void) { return enabled; }
+
+/* hand the decoder the next queued bytes, waiting for the encoder if needed */
+static FLAC__StreamDecoderReadStatus verify_read(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data) {
+	struct verify *v = (struct verify *) client_data;
+	struct verify_chunk *c;
+	size_t n;
+
+	pthread_mutex_lock(&v->lock);
+	while (v->head == NULL && !v->eof) {
+		pthread_cond_wait(&v->ready, &v->lock);
+	}
+	c = v->head;
+	if (c == NULL) {
+		pthread_mutex_unlock(&v->lock);
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	n = c->len - c->pos < *bytes ? c->len - c->pos : *bytes;
+	memcpy(buffer, c->data + c->pos, n);
+	c->pos += n;
+	v->queued -= n;
+	pthread_cond_signal(&v->room);
+	if (c->pos == c->len) {
+		v->head = c->next;
+		if (v->head == NULL) {
+			v->tail = NULL;
+		}
+		free(c);
+	}
+	pthread_mutex_unlock(&v->lock);
+
+	*bytes = n;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderWriteStatus verify_write(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data) {
+	struct verify *v = (struct verify *) client_data;
+	uint32_t i;
+
+	for (i = 0; i < frame->header.blocksize; i++) {
+		v->pcm[i] = (int16_t) buffer[0][i];
+	}
+	md5_update_samples(&v->md5, v->pcm, frame->header.blocksize);
+	v->decoded += frame->header.blocksize;
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void verify_error(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data) {
+	struct verify *v = (struct verify *) client_data;
+
+	fprintf(stderr, "ERROR: verifying output: %s\n", FLAC__StreamDecoderErrorStatusString[status]);
+	v->failed = 1;
+}
+
+/* decode everything queued until verify_finish() marks the end of the stream */
+static void *verify_run(void *arg) {
+	struct verify *v = (struct verify *) arg;
+	FLAC__StreamDecoder *decoder;
+	FLAC__StreamDecoderInitStatus init_status;
+
+	decoder = FLAC__stream_decoder_new();
+	if (decoder == NULL) {
+		fprintf(stderr, "ERROR: allocating verify decoder\n");
+		v->failed = 1;
+	} else {
+		/* the header still has a zeroed MD5 while the encoder is running; compare it ourselves */
+		FLAC__stream_decoder_set_md5_checking(decoder, false);
+		init_status = FLAC__stream_decoder_init_stream(decoder, verify_read, NULL, NULL, NULL, NULL, verify_write, NULL, verify_error, v);
+		if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+			fprintf(stderr, "ERROR: initializing verify decoder: %s\n", FLAC__StreamDecoderInitStatusString[init_status]);
+			v->failed = 1;
+		} else if (!FLAC__stream_decoder_process_until_end_of_stream(decoder)) {
+			v->failed = 1;
+		}
+		FLAC__stream_decoder_finish(decoder);
+		FLAC__stream_decoder_delete(decoder);
+	}
+
+	/* drop whatever the decoder didn't get to, and everything after, so verify_feed() never blocks */
+	pthread_mutex_lock(&v->lock);
+	while (v->head != NULL) {
+		struct verify_chunk *c = v->head;
+		v->head = c->next;
+		free(c);
+	}
+	v->tail = NULL;
+	v->queued = 0;
+	v->done = 1;
+	pthread_cond_broadcast(&v->room);
+	pthread_mutex_unlock(&v->lock);
+
+	return NULL;
+}
+
+/*
+ * Start decoding on a separate thread; feed it the encoded bytes as they
+ * are written. `samples` may be NULL when the source is only known by its
+ * digest, see verify_finish_digest().
+ */
+struct verify *verify_start(const int16_t *samples, size_t nsamples) {
+	struct verify *v;
+
+	v = (struct verify *) malloc(sizeof(struct verify));
+	if (v == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	memset(v, 0, offsetof(struct verify, pcm));
+	v->samples = samples;
+	v->nsamples = nsamples;
+	md5_init(&v->md5);
+	pthread_mutex_init(&v->lock, NULL);
+	pthread_cond_init(&v->ready, NULL);
+	pthread_cond_init(&v->room, NULL);
+
+	if (pthread_create(&v->thread, NULL, verify_run, v) != 0) {
+		fprintf(stderr, "pthread_create failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return v;
+}
+
+/* queue `len` bytes for the decoder, waiting while VERIFY_QUEUE_BYTES are already queued */
+int verify_feed(struct verify *v, const unsigned char *data, size_t len) {
+	struct verify_chunk *c;
+
+	if (len == 0) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&v->lock);
+	while (!v->done && v->queued > 0 && v->queued + len > VERIFY_QUEUE_BYTES) {
+		pthread_cond_wait(&v->room, &v->lock);
+	}
+	if (v->done) {
+		pthread_mutex_unlock(&v->lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&v->lock);
+
+	c = (struct verify_chunk *) malloc(sizeof(struct verify_chunk) + len);
+	if (c == NULL) {
+		return -1;
+	}
+	c->next = NULL;
+	c->len = len;
+	c->pos = 0;
+	memcpy(c->data, data, len);
+
+	pthread_mutex_lock(&v->lock);
+	if (v->tail == NULL) {
+		v->head = c;
+	} else {
+		v->tail->next = c;
+	}
+	v->tail = c;
+	v->queued += len;
+	pthread_cond_signal(&v->ready);
+	pthread_mutex_unlock(&v->lock);
+
+	return 0;
+}
+
+/* does every seek point in the SEEKTABLE body `p` name the first sample and offset of one of the `frames`? */
+static int verify_seektable(const unsigned char *p, size_t len, const struct frame_list *frames) {
+	uint64_t sample;
+	uint64_t offset;
+	uint64_t prev = 0;
+	int first = 1;
+	size_t lo;
+	size_t hi;
+	size_t mid;
+	size_t i;
+
+	for (i = 0; i + 18 <= len; i += 18) {
+		sample = bytes_get_be(p + i, 8);
+		offset = bytes_get_be(p + i + 8, 8);
+		if (sample == UINT64_MAX) {	/* placeholder */
+			continue;
+		}
+		if (!first && sample <= prev) {
+			fprintf(stderr, "ERROR: verifying output: seek points out of order at sample %" PRIu64 "\n", sample);
+			return -1;
+		}
+		prev = sample;
+		first = 0;
+
+		lo = 0;
+		hi = frames->len;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (frames->frames[mid].sample < sample) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		if (lo == frames->len || frames->frames[lo].sample != sample || frames->frames[lo].offset - frames->frames[0].offset != offset
+				|| frames->frames[lo].samples != bytes_get_be(p + i + 16, 2)) {
+			fprintf(stderr, "ERROR: verifying output: seek point for sample %" PRIu64 " doesn't match a frame\n", sample);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Read back the metadata of the finished file `filepath`, after libFLAC
+ * rewrote it: STREAMINFO is kept for verify_finish() and the seek table,
+ * if any, is checked against `frames` unless it is NULL. A descriptor
+ * output can't be opened again and is skipped.
+ */
+void verify_output(struct verify *v, const char *filepath, const struct frame_list *frames) {
+	unsigned char head[4];
+	unsigned char *body;
+	size_t len;
+	int last = 0;
+	FILE *f;
+
+	if (output_is_descriptor(filepath)) {
+		return;
+	}
+
+	f = fopen(filepath, "rb");
+	if (f == NULL || fread(head, 1, 4, f) != 4 || memcmp(head, "fLaC", 4) != 0) {
+		fprintf(stderr, "ERROR: verifying output: could not read the stream header of '%s'\n", filepath);
+		v->bad_output = 1;
+		if (f != NULL) {
+			fclose(f);
+		}
+		return;
+	}
+
+	while (!last && !v->bad_output) {
+		if (fread(head, 1, 4, f) != 4) {
+			fprintf(stderr, "ERROR: verifying output: metadata of '%s' is cut short\n", filepath);
+			v->bad_output = 1;
+			break;
+		}
+		last = head[0] & 0x80;
+		len = bytes_get_be(head + 1, 3);
+
+		body = (unsigned char *) malloc(len > 0 ? len : 1);
+		if (body == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+		if (fread(body, 1, len, f) != len) {
+			fprintf(stderr, "ERROR: verifying output: metadata of '%s' is cut short\n", filepath);
+			v->bad_output = 1;
+		} else if ((head[0] & 0x7f) == 0 && len == 34) {	/* STREAMINFO */
+			v->total_samples = bytes_get_be(body + 13, 5) & 0xfffffffffULL;
+			memcpy(v->md5sum, body + 18, 16);
+			v->checked = 1;
+		} else if ((head[0] & 0x7f) == 3 && frames != NULL && verify_seektable(body, len, frames) == -1) {	/* SEEKTABLE */
+			v->bad_output = 1;
+		}
+		free(body);
+	}
+	fclose(f);
+
+	if (!v->bad_output && !v->checked) {
+		fprintf(stderr, "ERROR: verifying output: '%s' has no STREAMINFO\n", filepath);
+		v->bad_output = 1;
+	}
+}
+
+/*
+ * Mark the end of the stream, wait for the decoder and compare with the
+ * source: `nsamples` samples whose MD5 is `expected`. If verify_output()
+ * read the finished file, its STREAMINFO has to agree as well.
+ */
+int verify_finish_digest(struct verify *v, const unsigned char expected[16], size_t nsamples) {
+	unsigned char actual[16];
+	int rc = 0;
+
+	pthread_mutex_lock(&v->lock);
+	v->eof = 1;
+	pthread_cond_signal(&v->ready);
+	pthread_mutex_unlock(&v->lock);
+
+	pthread_join(v->thread, NULL);
+	md5_final(&v->md5, actual);
+
+	if (v->failed) {
+		rc = -1;
+	} else if (v->decoded != nsamples) {
+		fprintf(stderr, "ERROR: verifying output: decoded %zu samples, rendered %zu\n", v->decoded, nsamples);
+		rc = -1;
+	} else if (memcmp(expected, actual, 16) != 0) {
+		fprintf(stderr, "ERROR: verifying output: MD5 of the decoded audio doesn't match the rendered audio\n");
+		rc = -1;
+	} else if (v->bad_output) {
+		rc = -1;
+	} else if (v->checked && v->total_samples != (nsamples & 0xfffffffffULL)) {
+		fprintf(stderr, "ERROR: verifying output: STREAMINFO says %" PRIu64 " samples, rendered %zu\n", v->total_samples, nsamples);
+		rc = -1;
+	} else if (v->checked && memcmp(expected, v->md5sum, 16) != 0) {
+		fprintf(stderr, "ERROR: verifying output: MD5 in STREAMINFO doesn't match the rendered audio\n");
+		rc = -1;
+	}
+
+	pthread_cond_destroy(&v->room);
+	pthread_cond_destroy(&v->ready);
+	pthread_mutex_destroy(&v->lock);
+	free(v);
+
+	return rc;
+}
+
+/* same, comparing with the samples given to verify_start() */
+int verify_finish(struct verify *v) {
+	unsigned char expected[16];
+	struct md5 md5;
+
+	md5_init(&md5);
+	md5_update_samples(&md5, v->samples, v->nsamples);
+	md5_final(&md5, expected);
+
+	return verify_finish_digest(v, expected, v->nsamples);
+}
+
+/* deferred pass: decode a finished file */
+int verify_file(char *filepath, const int16_t *samples, size_t nsamples) {
+	struct verify *v;
+	unsigned char *buf;
+	FILE *f;
+	size_t n;
+	int rc = 0;
+
+	f = fopen(filepath, "rb");
+	if (f == NULL) {
+		fprintf(stderr, "ERROR: could not open '%s' to verify it\n", filepath);
+		return -1;
+	}
+
+	buf = (unsigned char *) malloc(VERIFY_READSIZE);
+	if (buf == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	v = verify_start(samples, nsamples);
+	while ((n = fread(buf, 1, VERIFY_READSIZE, f)) > 0) {
+		if (verify_feed(v, buf, n) == -1) {
+			rc = -1;
+			break;
+		}
+	}
+	if (ferror(f)) {
+		fprintf(stderr, "ERROR: reading '%s' to verify it\n", filepath);
+		rc = -1;
+	}
+	verify_output(v, filepath, NULL);
+	if (verify_finish(v) == -1) {
+		rc = -1;
+	}
+
+	free(buf);
+	fclose(f);
+
+	return rc;
+}
+
+/* decode bare frames, as from encoder_encode_frames(), behind a minimal STREAMINFO */
+int verify_frames(const int16_t *samples, size_t nsamples, const struct frame_list *l) {
+	unsigned char head[4 + 4 + 34];
+	struct verify *v;
+	uint64_t info;
+	size_t i;
+
+	memset(head, 0, sizeof(head));
+	memcpy(head, "fLaC", 4);
+	head[4] = 0x80;				/* last metadata block, STREAMINFO */
+	head[7] = 34;
+	head[8] = 16 >> 8;			/* min block size */
+	head[9] = 16 & 0xff;
+	head[10] = VERIFY_MAX_BLOCKSIZE >> 8;	/* max block size */
+	head[11] = VERIFY_MAX_BLOCKSIZE & 0xff;
+	info = ((uint64_t) SAMPLE_RATE << 44) | ((uint64_t) (CHANNELS - 1) << 41) | ((uint64_t) (BPS - 1) << 36) | (nsamples & 0xfffffffffULL);
+	for (i = 0; i < 8; i++) {
+		head[18 + i] = info >> (56 - 8 * i);
+	}
+
+	v = verify_start(samples, nsamples);
+	verify_feed(v, head, sizeof(head));
+	for (i = 0; i < l->len; i++) {
+		verify_feed(v, l->data + l->frames[i].offset, l->frames[i].bytes);
+	}
+
+	return verify_finish(v);
+}
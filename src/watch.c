@@ -0,0 +1,470 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Watch mode: convert every file that gets written into a directory, as
+ * soon as it is closed. Elements are set up once for the whole run and
+ * each worker keeps its render buffer and its libFLAC encoder between
+ * files, so a message costs a render and an encode rather than a process
+ * start.
+ *
+ * spool/msg.txt becomes spool/msg.flac. The output is encoded to a hidden
+ * temporary file next to it and renamed into place when it is complete
+ * (and verified), so readers of the directory never see a partial file.
+ * Text files already in the directory without an up to date output are
+ * converted at start.
+ *
+ * A path is never queued twice or converted by two workers at once. A
+ * file closed again while it is being converted is converted once more
+ * afterwards, if it changed since it was read.
+ */
+
+#include "encoder.h"
+#include "measure.h"
+#include "normalize.h"
+#include "render.h"
+#include "verify.h"
+#include "watch.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct watch_job {
+	char *path;
+	struct watch_job *next;
+};
+
+struct watch_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t more;
+	struct watch_job *head;
+	struct watch_job *tail;
+	int stop;
+	struct watch_worker *workers;
+	int nworkers;
+
+	struct measure m;
+	int verbose;
+	int failed;
+};
+
+struct watch_worker {
+	struct watch_pool *pool;
+	int id;
+	pthread_t thread;
+
+	/* under the pool's lock */
+	const char *current;	/* being converted */
+	int again;		/* closed again since */
+
+	struct timespec mtime;	/* of `current` when it was read */
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void watch_signal(int sig) { stopping = 1; }
+
+/* "name.txt", but not hidden files (our own temporary files among them) */
+static int watch_wanted(const char *name) {
+	size_t len = strlen(name);
+	size_t ext = strlen(WATCH_INPUT);
+
+	return name[0] != '.' && len > ext && strcmp(name + len - ext, WATCH_INPUT) == 0;
+}
+
+static char *watch_path(const char *dir, const char *name) {
+	char *path;
+
+	path = (char *) malloc(strlen(dir) + strlen(name) + 2);
+	if (path == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(path, "%s/%s", dir, name);
+
+	return path;
+}
+
+/* spool/msg.txt -> spool/msg.flac */
+static char *watch_output_name(const char *path) {
+	size_t stem = strlen(path) - strlen(WATCH_INPUT);
+	char *out;
+
+	out = (char *) malloc(stem + strlen(WATCH_OUTPUT) + 1);
+	if (out == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(out, "%.*s%s", (int) stem, path, WATCH_OUTPUT);
+
+	return out;
+}
+
+/* spool/msg.flac -> spool/.msg.flac.ID.tmp */
+static char *watch_temp_name(const char *out, int id) {
+	const char *slash = strrchr(out, '/');
+	size_t dir = slash == NULL ? 0 : slash - out + 1;
+	char *tmp;
+
+	tmp = (char *) malloc(strlen(out) + 32);
+	if (tmp == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(tmp, "%.*s.%s.%d.tmp", (int) dir, out, out + dir, id);
+
+	return tmp;
+}
+
+/* queue `path` (taken over) for the workers, unless it is queued already or being converted */
+static void watch_queue(struct watch_pool *pool, char *path) {
+	struct watch_job *job;
+	struct watch_job *q;
+	int i;
+
+	job = (struct watch_job *) malloc(sizeof(struct watch_job));
+	if (job == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	job->path = path;
+	job->next = NULL;
+
+	/* the check and the append under one hold, workers queue too */
+	pthread_mutex_lock(&pool->lock);
+	for (q = pool->head; q != NULL && strcmp(q->path, path) != 0; q = q->next);
+	for (i = 0; q == NULL && i < pool->nworkers; i++) {
+		if (pool->workers[i].current != NULL && strcmp(pool->workers[i].current, path) == 0) {
+			pool->workers[i].again = 1;
+			break;
+		}
+	}
+	if (q == NULL && i == pool->nworkers) {
+		if (pool->tail == NULL) {
+			pool->head = job;
+		} else {
+			pool->tail->next = job;
+		}
+		pool->tail = job;
+		pthread_cond_signal(&pool->more);
+		job = NULL;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (job != NULL) {
+		free(job->path);
+		free(job);
+	}
+}
+
+/* queue the text files in `dir` whose output is missing or older */
+static void watch_scan(struct watch_pool *pool, const char *dir) {
+	DIR *d;
+	struct dirent *e;
+	struct stat in;
+	struct stat out;
+	char *path;
+	char *output;
+
+	d = opendir(dir);
+	if (d == NULL) {
+		return;
+	}
+
+	while ((e = readdir(d)) != NULL) {
+		if (!watch_wanted(e->d_name)) {
+			continue;
+		}
+		path = watch_path(dir, e->d_name);
+		output = watch_output_name(path);
+		if (stat(path, &in) == 0 && S_ISREG(in.st_mode) && (stat(output, &out) == -1 || out.st_mtime < in.st_mtime)) {
+			watch_queue(pool, path);
+		} else {
+			free(path);
+		}
+		free(output);
+	}
+
+	closedir(d);
+}
+
+/* render and encode one file; `buf` and `cap` are the worker's render buffer, `es` its encoder */
+static int watch_convert(struct watch_worker *w, const char *path, int16_t **buf, size_t *cap, struct encoder_stream **es) {
+	struct watch_pool *pool = w->pool;
+	struct verify *verifier;
+	struct stat st;
+	FILE *input;
+	unsigned char *text;
+	size_t len;
+	size_t n;
+	char *out;
+	char *tmp;
+	int rc;
+
+	input = fopen(path, "r");
+	if (input == NULL) {
+		fprintf(stderr, "Could not open input file '%s'\n", path);
+		return -1;
+	}
+	if (fstat(fileno(input), &st) == 0) {
+		w->mtime = st.st_mtim;
+	}
+	text = render_read(input, &len);
+	fclose(input);
+
+	n = measure_text(&pool->m, text, len, 0);
+	if (n > *cap) {
+		free(*buf);
+		*cap = n;
+		*buf = (int16_t *) malloc(*cap * sizeof(int16_t));
+		if (*buf == NULL) {
+			fprintf(stderr, "malloc failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	render_span(*buf, text, len, 0);
+	free(text);
+
+	out = watch_output_name(path);
+	tmp = watch_temp_name(out, w->id);
+
+	verifier = verify_is_enabled() ? verify_start(*buf, n) : NULL;
+	*es = encoder_stream_reopen(*es, tmp, n, verifier);
+	encoder_stream_write(*es, *buf, n);
+	rc = encoder_stream_finish(*es, NULL);
+	if (verifier != NULL && verify_finish(verifier) != 0) {
+		fprintf(stderr, "'%s' failed verification\n", out);
+		rc = -1;
+	}
+	if (rc == 0 && rename(tmp, out) == -1) {
+		rc = -1;
+	}
+
+	if (rc != 0) {
+		fprintf(stderr, "Could not write output file '%s'\n", out);
+		unlink(tmp);
+	} else if (pool->verbose > 0) {
+		fprintf(stdout, "%s -> %s (%.3f s)\n", path, out, (double) n / SAMPLE_RATE);
+		fflush(stdout);
+	}
+
+	free(out);
+	free(tmp);
+
+	return rc;
+}
+
+static void *watch_worker(void *arg) {
+	struct watch_worker *w = (struct watch_worker *) arg;
+	struct watch_pool *pool = w->pool;
+	struct encoder_stream *es = NULL;
+	struct watch_job *job;
+	struct stat st;
+	int16_t *buf = NULL;
+	size_t cap = 0;
+	int again;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		while (pool->head == NULL && !pool->stop) {
+			pthread_cond_wait(&pool->more, &pool->lock);
+		}
+		job = pool->head;
+		if (job != NULL) {
+			pool->head = job->next;
+			pool->tail = pool->head == NULL ? NULL : pool->tail;
+			w->current = job->path;
+			w->again = 0;
+		}
+		pthread_mutex_unlock(&pool->lock);
+
+		if (job == NULL) {
+			break;
+		}
+
+		memset(&w->mtime, 0, sizeof(struct timespec));
+		if (watch_convert(w, job->path, &buf, &cap, &es) == -1) {
+			pthread_mutex_lock(&pool->lock);
+			pool->failed = 1;
+			pthread_mutex_unlock(&pool->lock);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		w->current = NULL;
+		again = w->again;
+		pthread_mutex_unlock(&pool->lock);
+
+		/* written again while it was being converted: once more if that changed it */
+		if (again && stat(job->path, &st) == 0 && (st.st_mtim.tv_sec != w->mtime.tv_sec || st.st_mtim.tv_nsec != w->mtime.tv_nsec)) {
+			watch_queue(pool, job->path);
+		} else {
+			free(job->path);
+		}
+		free(job);
+	}
+
+	free(buf);
+	encoder_stream_free(es);
+
+	return NULL;
+}
+
+/*
+ * Convert text files written into any of `dirs` on `jobs` workers until
+ * interrupted (SIGINT or SIGTERM); files already queued are finished
+ * first. Returns 0, or -1 if the directories can't be watched or any
+ * conversion failed.
+ */
+int watch_run(char **dirs, int ndirs, int jobs, int verbose) {
+	struct watch_pool pool;
+	struct watch_worker *workers;
+	struct normalize st;
+	struct sigaction sa;
+	struct inotify_event *ev;
+	char events[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	int *wds;
+	int fd;
+	ssize_t got;
+	ssize_t off;
+	int nworkers = jobs < 1 ? 1 : jobs;
+	int rc = 0;
+	int i;
+
+	memset(&pool, 0, sizeof(struct watch_pool));
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.more, NULL);
+	render_measure(&pool.m);
+	pool.verbose = verbose;
+	normalize_init(&st);	/* sets up the tables before the workers share them */
+
+	fd = inotify_init1(IN_CLOEXEC);
+	if (fd == -1) {
+		fprintf(stderr, "Could not start watching: %s\n", strerror(errno));
+		return -1;
+	}
+
+	wds = (int *) malloc(ndirs * sizeof(int));
+	if (wds == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < ndirs; i++) {
+		/* closed after writing, or moved in whole */
+		wds[i] = inotify_add_watch(fd, dirs[i], IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+		if (wds[i] == -1) {
+			fprintf(stderr, "Could not watch directory '%s': %s\n", dirs[i], strerror(errno));
+			close(fd);
+			free(wds);
+			return -1;
+		}
+	}
+
+	/* no SA_RESTART: a signal has to interrupt the read below */
+	memset(&sa, 0, sizeof(struct sigaction));
+	sa.sa_handler = watch_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	workers = (struct watch_worker *) malloc(nworkers * sizeof(struct watch_worker));
+	if (workers == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	memset(workers, 0, nworkers * sizeof(struct watch_worker));
+	pool.workers = workers;
+	pool.nworkers = nworkers;
+	for (i = 0; i < nworkers; i++) {
+		workers[i].pool = &pool;
+		workers[i].id = i;
+		if (pthread_create(&workers[i].thread, NULL, watch_worker, &workers[i]) != 0) {
+			fprintf(stderr, "pthread_create failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* the watches are in place, so nothing written from here on is missed */
+	for (i = 0; i < ndirs; i++) {
+		watch_scan(&pool, dirs[i]);
+	}
+
+	while (!stopping) {
+		got = read(fd, events, sizeof(events));
+		if (got == -1 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			fprintf(stderr, "Could not read directory events: %s\n", strerror(errno));
+			rc = -1;
+			break;
+		}
+
+		for (off = 0; off < got; off += sizeof(struct inotify_event) + ev->len) {
+			ev = (struct inotify_event *) (events + off);
+
+			if (ev->mask & IN_Q_OVERFLOW) {
+				/* events were lost, look for what changed */
+				for (i = 0; i < ndirs; i++) {
+					watch_scan(&pool, dirs[i]);
+				}
+				continue;
+			}
+			if (ev->len == 0 || (ev->mask & IN_ISDIR) || !watch_wanted(ev->name)) {
+				continue;
+			}
+			for (i = 0; i < ndirs && wds[i] != ev->wd; i++);
+			if (i < ndirs) {
+				watch_queue(&pool, watch_path(dirs[i], ev->name));
+			}
+		}
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.stop = 1;
+	pthread_cond_broadcast(&pool.more);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < nworkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	if (pool.failed) {
+		rc = -1;
+	}
+
+	free(workers);
+	free(wds);
+	close(fd);
+	pthread_mutex_destroy(&pool.lock);
+	pthread_cond_destroy(&pool.more);
+
+	return rc;
+}
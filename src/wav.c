@@ -0,0 +1,171 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bytes.h"
+#include "output.h"
+#include "wav.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t wav_le32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24); }
+static uint16_t wav_le16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+#define WRITESIZE (32 * 1024)
+
+/*
+ * Read a PCM WAVE file (8 or 16 bits per sample). Only the first channel
+ * is kept. Returns 0 on success with a malloc'd sample buffer, -1 if the
+ * file can't be read or isn't PCM WAVE.
+ */
+int wav_read(char *filepath, int16_t **samples, size_t *len, int *rate) {
+	FILE *in;
+	unsigned char hdr[12];
+	unsigned char chunk[8];
+	unsigned char fmt[16];
+	unsigned char *data = NULL;
+	uint32_t size;
+	int channels = 0;
+	int bps = 0;
+	int have_fmt = 0;
+	size_t frame;
+	size_t i;
+
+	*samples = NULL;
+	*len = 0;
+
+	in = fopen(filepath, "rb");
+	if (in == NULL) {
+		return -1;
+	}
+
+	if (fread(hdr, 1, sizeof(hdr), in) != sizeof(hdr) || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+		fclose(in);
+		return -1;
+	}
+
+	while (fread(chunk, 1, sizeof(chunk), in) == sizeof(chunk)) {
+		size = wav_le32(chunk + 4);
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && size >= sizeof(fmt)) {
+			if (fread(fmt, 1, sizeof(fmt), in) != sizeof(fmt)) {
+				break;
+			}
+			fseek(in, size - sizeof(fmt) + (size & 1), SEEK_CUR);
+			if (wav_le16(fmt) != 1) { /* PCM only */
+				break;
+			}
+			channels = wav_le16(fmt + 2);
+			*rate = wav_le32(fmt + 4);
+			bps = wav_le16(fmt + 14);
+			have_fmt = channels > 0 && (bps == 8 || bps == 16);
+		} else if (memcmp(chunk, "data", 4) == 0 && have_fmt) {
+			data = (unsigned char *) malloc(size > 0 ? size : 1);
+			if (data == NULL) {
+				break;
+			}
+			size = fread(data, 1, size, in);
+
+			frame = channels * (bps / 8);
+			*len = size / frame;
+			*samples = (int16_t *) malloc((*len > 0 ? *len : 1) * sizeof(int16_t));
+			if (*samples == NULL) {
+				break;
+			}
+			for (i = 0; i < *len; i++) {
+				const unsigned char *p = data + i * frame;
+				(*samples)[i] = bps == 16 ? (int16_t) wav_le16(p) : (int16_t) ((p[0] - 128) << 8);
+			}
+			break;
+		} else {
+			fseek(in, size + (size & 1), SEEK_CUR);
+		}
+	}
+
+	free(data);
+	fclose(in);
+
+	return *samples != NULL ? 0 : -1;
+}
+
+/*
+ * Write mono 16-bit samples as a PCM WAVE file, or as headerless
+ * little-endian samples (raw PCM) when `header` is 0.
+ */
+int wav_write(char *filepath, const int16_t *samples, size_t len, int rate, int header) {
+	static const unsigned char fmt[] = { 'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0 };
+	unsigned char hdr[44];
+	unsigned char *buf;
+	struct output *out;
+	size_t i;
+	size_t n;
+	int ok = 1;
+
+	if (header && len * 2 > 0xffffffffUL - 36) {
+		fprintf(stderr, "Too much audio for a WAVE file, use raw output instead\n");
+		return -1;
+	}
+
+	out = output_open(filepath);
+	if (out == NULL) {
+		fprintf(stderr, "Could not open output file '%s'\n", filepath);
+		return -1;
+	}
+
+	if (header) {
+		memcpy(hdr, "RIFF", 4);
+		bytes_put_le(hdr + 4, 36 + len * 2, 4);
+		memcpy(hdr + 8, "WAVE", 4);
+		memcpy(hdr + 12, fmt, sizeof(fmt));
+		bytes_put_le(hdr + 24, rate, 4);
+		bytes_put_le(hdr + 28, rate * 2, 4);
+		bytes_put_le(hdr + 32, 2, 2);
+		bytes_put_le(hdr + 34, 16, 2);
+		memcpy(hdr + 36, "data", 4);
+		bytes_put_le(hdr + 40, len * 2, 4);
+		ok &= output_write(out, hdr, sizeof(hdr)) == 0;
+	}
+
+	buf = (unsigned char *) malloc(WRITESIZE * 2);
+	if (buf == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+
+	while (ok && len > 0) {
+		n = len < WRITESIZE ? len : WRITESIZE;
+		for (i = 0; i < n; i++) {
+			bytes_put_le(buf + 2 * i, (uint16_t) samples[i], 2);
+		}
+		ok &= output_write(out, buf, n * 2) == 0;
+		samples += n;
+		len -= n;
+	}
+	free(buf);
+
+	ok &= output_close(out) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write output file '%s'\n", filepath);
+	}
+
+	return ok ? 0 : -1;
+}
@@ -0,0 +1,103 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * The worker pool behind the modes that turn one run into many outputs
+ * (segments, variants, shards, decoding many files): items are handed
+ * out in order from a shared index, and the calling thread works through
+ * them alongside the others instead of only waiting for them.
+ */
+
+#include "work.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct work_pool {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t nitems;
+	int stop;
+	int (*fn)(void *arg, size_t item);
+	void *arg;
+};
+
+static void *work_worker(void *arg) {
+	struct work_pool *pool = (struct work_pool *) arg;
+	size_t item;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		item = pool->next < pool->nitems && !pool->stop ? pool->next++ : pool->nitems;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (item == pool->nitems) {
+			break;
+		}
+
+		if (pool->fn(pool->arg, item) == -1) {
+			pthread_mutex_lock(&pool->lock);
+			pool->stop = 1;
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Call `fn` with `arg` for each item in [0, `nitems`), on at most `jobs`
+ * threads counting this one. Returns once every item handed out is done.
+ */
+void work_run(size_t nitems, int jobs, int (*fn)(void *arg, size_t item), void *arg) {
+	struct work_pool pool;
+	pthread_t *threads;
+	size_t i;
+	int nthreads;
+
+	pool.next = 0;
+	pool.nitems = nitems;
+	pool.stop = 0;
+	pool.fn = fn;
+	pool.arg = arg;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	nthreads = jobs < 1 ? 1 : jobs;
+	nthreads = (size_t) nthreads > nitems ? (int) nitems : nthreads;
+	threads = (pthread_t *) malloc((nthreads > 0 ? nthreads : 1) * sizeof(pthread_t));
+	if (threads == NULL) {
+		fprintf(stderr, "malloc failed :(\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 1; i < (size_t) nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, work_worker, &pool) != 0) {
+			fprintf(stderr, "pthread_create failed :(\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	work_worker(&pool);
+	for (i = 1; i < (size_t) nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	free(threads);
+	pthread_mutex_destroy(&pool.lock);
+}
@@ -0,0 +1,144 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Every kernel level this CPU runs must give exactly what the scalar
+ * kernels give. Each one is run on every length up to a few vectors and
+ * from every offset within one, so the vector loops, the scalar tails and
+ * unaligned starts are all covered, and nothing may be written past the
+ * end.
+ */
+
+#include "kernels.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LEN (131)		/* a few 64 byte vectors of int16_t plus an odd tail */
+#define MAX_OFFSET (32)		/* every misalignment of a 64 byte vector of int16_t */
+#define GUARD (16)		/* samples after the end that must stay untouched */
+#define FILL (0x5a5a)
+
+static int16_t src[MAX_OFFSET + MAX_LEN + GUARD];
+static int16_t want16[MAX_OFFSET + MAX_LEN + GUARD];
+static int16_t got16[MAX_OFFSET + MAX_LEN + GUARD];
+static int32_t want32[MAX_OFFSET + MAX_LEN + GUARD];
+static int32_t got32[MAX_OFFSET + MAX_LEN + GUARD];
+
+static int failures = 0;
+
+static void fail(const char *level, const char *kernel, size_t offset, size_t len) {
+	fprintf(stderr, "FAIL: %s %s differs from scalar at offset %zu, length %zu\n", level, kernel, offset, len);
+	failures++;
+}
+
+static void fill16(int16_t *dst) {
+	size_t i;
+
+	for (i = 0; i < MAX_OFFSET + MAX_LEN + GUARD; i++) {
+		dst[i] = FILL;
+	}
+}
+
+static void fill32(int32_t *dst) {
+	size_t i;
+
+	for (i = 0; i < MAX_OFFSET + MAX_LEN + GUARD; i++) {
+		dst[i] = FILL;
+	}
+}
+
+static void check(const struct kernels *scalar, const struct kernels *k) {
+	double want_re[KERNELS_TONE_LANES], want_im[KERNELS_TONE_LANES];
+	double got_re[KERNELS_TONE_LANES], got_im[KERNELS_TONE_LANES];
+	double step = 2.0 * M_PI * 613.0 / 8000.0;
+	size_t offset, len;
+	int lane;
+
+	for (offset = 0; offset < MAX_OFFSET; offset++) {
+		for (len = 0; len <= MAX_LEN; len++) {
+			fill32(want32); fill32(got32);
+			scalar->widen(want32 + offset, src + offset, len);
+			k->widen(got32 + offset, src + offset, len);
+			if (memcmp(want32, got32, sizeof(want32)) != 0) {
+				fail(k->name, "widen", offset, len);
+			}
+
+			fill16(want16); fill16(got16);
+			scalar->copy(want16 + offset, src + offset, len);
+			k->copy(got16 + offset, src + offset, len);
+			if (memcmp(want16, got16, sizeof(want16)) != 0) {
+				fail(k->name, "copy", offset, len);
+			}
+
+			fill16(want16); fill16(got16);
+			scalar->zero(want16 + offset, len);
+			k->zero(got16 + offset, len);
+			if (memcmp(want16, got16, sizeof(want16)) != 0) {
+				fail(k->name, "zero", offset, len);
+			}
+
+			/* the phasors come back rotated too, and a later call goes on from them */
+			for (lane = 0; lane < KERNELS_TONE_LANES; lane++) {
+				want_re[lane] = got_re[lane] = cos(lane * step);
+				want_im[lane] = got_im[lane] = sin(lane * step);
+			}
+			fill16(want16); fill16(got16);
+			scalar->phasor(want16 + offset, len, want_re, want_im, cos(KERNELS_TONE_LANES * step), sin(KERNELS_TONE_LANES * step), 32000.0);
+			k->phasor(got16 + offset, len, got_re, got_im, cos(KERNELS_TONE_LANES * step), sin(KERNELS_TONE_LANES * step), 32000.0);
+			if (memcmp(want16, got16, sizeof(want16)) != 0 || memcmp(want_re, got_re, sizeof(want_re)) != 0 || memcmp(want_im, got_im, sizeof(want_im)) != 0) {
+				fail(k->name, "phasor", offset, len);
+			}
+		}
+	}
+}
+
+int main(void) {
+	const struct kernels *scalar = kernels_level(KERNELS_SCALAR);
+	const struct kernels *k;
+	uint32_t x = 12345;
+	size_t i;
+	int level;
+
+	/* full range samples, including both extremes */
+	for (i = 0; i < sizeof(src) / sizeof(src[0]); i++) {
+		x = x * 1103515245 + 12345;
+		src[i] = (int16_t) (x >> 16);
+	}
+	src[1] = INT16_MIN;
+	src[2] = INT16_MAX;
+
+	for (level = KERNELS_SCALAR + 1; level < KERNELS_LEVELS; level++) {
+		k = kernels_level(level);
+		if (k == NULL) {
+			fprintf(stdout, "level %d: not available, skipped\n", level);
+			continue;
+		}
+		check(scalar, k);
+		fprintf(stdout, "%s: checked\n", k->name);
+	}
+
+	fprintf(stdout, "best: %s\n", kernels_get()->name);
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+ /*
+    text-to-morse -- converts text into a morse code audio file
+    Copyright (C) 2024  Thomas Cort
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/*
+ * Build-time generator for the preset waveform tables (see presets.h).
+ * Linked against tone.c built with TEXT_TO_MORSE_NO_PRESETS, so the
+ * tables hold exactly what tone_init() renders at runtime.
+ *
+ * usage: text-to-morse-presets OUTPUT.C WPM:FREQUENCY...
+ */
+
+#include "nsamples.h"
+#include "tone.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void presets_table(FILE *out, const char *name, const int16_t *samples, size_t len) {
+	size_t i;
+
+	fprintf(out, "static const int16_t %s[%zu] = {", name, len);
+	for (i = 0; i < len; i++) {
+		fprintf(out, "%s%d,", i % 16 == 0 ? "\n\t" : " ", samples[i]);
+	}
+	fprintf(out, "\n};\n\n");
+}
+
+int main(int argc, char *argv[]) {
+	FILE *out;
+	size_t silence_len = 0;
+	int wpm;
+	int frequency;
+	int i;
+	int j;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s OUTPUT.C WPM:FREQUENCY...\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	out = fopen(argv[1], "w");
+	if (out == NULL) {
+		fprintf(stderr, "Could not open output file '%s'\n", argv[1]);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(out, "/* generated by tools/presets.c -- do not edit */\n\n");
+	fprintf(out, "#include \"presets.h\"\n\n");
+
+	for (i = 2; i < argc; i++) {
+		char name[64];
+
+		if (sscanf(argv[i], "%d:%d", &wpm, &frequency) != 2 || wpm < 1 || wpm > 100 || frequency < 300 || frequency > 1200) {
+			fprintf(stderr, "Invalid preset '%s', expected WPM:FREQUENCY\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+		for (j = 2; j < i; j++) {
+			int other_wpm, other_frequency;
+
+			if (sscanf(argv[j], "%d:%d", &other_wpm, &other_frequency) == 2 && other_wpm == wpm && other_frequency == frequency) {
+				fprintf(stderr, "Duplicate preset '%s'\n", argv[i]);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		if (tone_init(wpm, frequency) == -1) {
+			fprintf(stderr, "Failed to initialize tones\n");
+			exit(EXIT_FAILURE);
+		}
+		snprintf(name, sizeof(name), "dit_%d_%d", wpm, frequency);
+		presets_table(out, name, tone_get_dit(), tone_get_dit_len());
+		snprintf(name, sizeof(name), "dah_%d_%d", wpm, frequency);
+		presets_table(out, name, tone_get_dah(), tone_get_dah_len());
+		tone_exit();
+
+		/* the inter-word space is the longest */
+		if ((size_t) nsamples_inter_word_space(wpm) > silence_len) {
+			silence_len = nsamples_inter_word_space(wpm);
+		}
+	}
+
+	fprintf(out, "const struct preset presets[] = {\n");
+	for (i = 2; i < argc; i++) {
+		sscanf(argv[i], "%d:%d", &wpm, &frequency);
+		fprintf(out, "\t{ %d, %d, dit_%d_%d, %d, dah_%d_%d, %d },\n", wpm, frequency, wpm, frequency, nsamples_dit(wpm), wpm, frequency, nsamples_dah(wpm));
+	}
+	fprintf(out, "\t{ 0, 0, NULL, 0, NULL, 0 }\n};\n\n");
+	fprintf(out, "const size_t presets_len = %d;\n\n", argc - 2);
+	fprintf(out, "const int16_t presets_silence[%zu] = { 0 };\n", silence_len > 0 ? silence_len : 1);
+	fprintf(out, "const size_t presets_silence_len = %zu;\n", silence_len);
+
+	if (fclose(out) != 0) {
+		fprintf(stderr, "Could not write output file '%s'\n", argv[1]);
+		exit(EXIT_FAILURE);
+	}
+
+	return 0;
+}